@@ -377,6 +377,10 @@ void zoeDeleteCDS (zoeCDS cds) {
 		zoeDeleteFeatureVec(cds->introns);
 		cds->introns = NULL;
 	}
+	if (cds->post) {
+		zoeDeleteFeatureVec(cds->post);
+		cds->post = NULL;
+	}
 	if (cds->tx) {
 		zoeDeleteDNA(cds->tx);
 		cds->tx = NULL;
@@ -426,6 +430,7 @@ zoeCDS zoeNewCDS (const char * name, const zoeDNA dna, const zoeFeatureVec featu
 	cds->inc3        = 0;
 	cds->tx          = NULL;
 	cds->aa          = NULL;
+	cds->post        = NULL;
 	cds->start_found = 0;
 	cds->end_found   = 0;
 	cds->OK          = 0;
@@ -671,6 +676,37 @@ void zoeAntiCDS (zoeCDS cds, int length) {
 	for (i = 0; i < cds->introns->size; i++) {
 		zoeAntiFeature(cds->introns->elem[i], length);
 	}
+	
+	for (i = 0; cds->post && i < cds->post->size; i++) {
+		zoeAntiFeature(cds->post->elem[i], length);
+	}
+}
+
+void zoeShiftCDS (zoeCDS cds, coor_t offset) {
+	int i;
+	
+	cds->start += offset;
+	cds->end   += offset;
+	
+	for (i = 0; i < cds->exons->size; i++) {
+		cds->exons->elem[i]->start += offset;
+		cds->exons->elem[i]->end   += offset;
+		cds->exons->elem[i]->frame  = (cds->exons->elem[i]->frame + offset) % 3;
+	}
+	
+	for (i = 0; i < cds->introns->size; i++) {
+		cds->introns->elem[i]->start += offset;
+		cds->introns->elem[i]->end   += offset;
+	}
+	
+	for (i = 0; cds->post && i < cds->post->size; i++) {
+		cds->post->elem[i]->start += offset;
+		cds->post->elem[i]->end   += offset;
+		if (cds->post->elem[i]->label == Exon || cds->post->elem[i]->label == Einit
+			|| cds->post->elem[i]->label == Eterm || cds->post->elem[i]->label == Esngl) {
+			cds->post->elem[i]->frame = (cds->post->elem[i]->frame + offset) % 3;
+		}
+	}
 }
 
 void zoeWriteCDS (FILE * stream, const zoeCDS cds) {
@@ -53,6 +53,7 @@ struct zoeCDS  {
 	zoeFeatureVec   introns;     /* introns */
 	zoeDNA          tx;          /* transcript */
 	zoeProtein      aa;          /* protein */
+	zoeFeatureVec   post;        /* posterior probabilities, or NULL */
 	
 	/* partial genes */
 	int     start_found;
@@ -71,6 +72,7 @@ typedef struct zoeCDS * zoeCDS;
 void    zoeDeleteCDS (zoeCDS);
 zoeCDS  zoeNewCDS (const char *, const zoeDNA, const zoeFeatureVec);
 void    zoeAntiCDS (zoeCDS, coor_t);
+void    zoeShiftCDS (zoeCDS, coor_t);
 void    zoeWriteCDS (FILE *, const zoeCDS);
 void    zoeWriteFullCDS (FILE *, const zoeCDS);
 void    zoeWriteTriteCDS (FILE *, const zoeCDS);
@@ -70,9 +70,43 @@ static char s5CodonTable[5][5][5] = {
 
 };
 
+static void fill_kmers (zoeDNA dna, struct zoeKmers * k) {
+	int i, c, top = 1;
+	
+	/* Horner's rule at 0, then rolled one base at a time */
+	for (i = 0; i <= dna->length; i++) {
+		if (k->code8) k->code8[i]  = 0;
+		else          k->code16[i] = 0;
+	}
+	if (k->length < 1 || dna->length < k->length) return;
+	for (i = 1; i < k->length; i++) top *= k->symbols;
+	for (i = 0, c = 0; i < k->length; i++) c = c * k->symbols + dna->s5[i];
+	for (i = 0; i + k->length <= dna->length; i++) {
+		if (i) c = (c - dna->s5[i-1] * top) * k->symbols + dna->s5[i + k->length -1];
+		if (k->code8) k->code8[i]  = c;
+		else          k->code16[i] = c;
+	}
+}
+
+void zoeDropKmerCodes (zoeDNA dna) {
+	int i;
+	
+	/* scanners holding these must be told, see zoeDropScannerCodes */
+	for (i = 0; i < dna->kmer_sets; i++) {
+		if (dna->kmers[i]->code8)  zoeFree(dna->kmers[i]->code8);
+		if (dna->kmers[i]->code16) zoeFree(dna->kmers[i]->code16);
+		zoeFree(dna->kmers[i]);
+	}
+	if (dna->kmers) zoeFree(dna->kmers);
+	dna->kmers     = NULL;
+	dna->kmer_sets = 0;
+}
+
 static void zoe_s5_stats (zoeDNA dna) {
 	int i;
 	
+	/* s5 has changed; codes are refilled in place, scanners keep them */
+	for (i = 0; i < dna->kmer_sets; i++) fill_kmers(dna, dna->kmers[i]);
 	for (i = 0; i < 5; i++) dna->f5[i] = 0;
 	for (i = 0; i < 5; i++) dna->c5[i] = 0;
 	if (dna->length == 0) return;
@@ -105,6 +139,7 @@ void zoeDeleteDNA(zoeDNA dna) {
 	if (dna->seq) {zoeFree(dna->seq); dna->seq = NULL;}
 	if (dna->s5)  {zoeFree(dna->s5);  dna->s5  = NULL;}
 	if (dna->s16) {zoeFree(dna->s16); dna->s16 = NULL;}
+	zoeDropKmerCodes(dna);
 	
 	zoeFree(dna);
 	dna = NULL;
@@ -119,6 +154,8 @@ zoeDNA zoeNewDNA (const char * def, const char * seq) {
 	dna->s5     = zoeMalloc(dna->length +1);
 	dna->s16    = zoeMalloc(dna->length +1);
 	dna->def    = zoeMalloc(strlen(def) +1);
+	dna->kmers     = NULL;
+	dna->kmer_sets = 0;
 	
 	/* set sequence and definition */
 	strcpy(dna->def, def);
@@ -580,4 +617,37 @@ zoeDNA zoeMakePaddedDNA (const zoeDNA real_dna, int padding) {
 	return dna;
 }
 
+const struct zoeKmers* zoeKmerCodes (zoeDNA dna, int symbols, int length) {
+	int               i, codes;
+	struct zoeKmers * k;
+	
+	/*
+		code[i] is the zoeScoreLUT index of s5[i..i+length-1], made in one
+		pass and shared by every LUT of that size, in one byte per position
+		where symbols^length allows, else two. Larger LUTs get NULL and
+		index the sequence themselves. Positions without a whole k-mer are
+		0. Not thread-safe: call before sharing the DNA.
+	*/
+	
+	for (i = 0; i < dna->kmer_sets; i++) {
+		k = dna->kmers[i];
+		if (k->symbols == symbols && k->length == length) return k;
+	}
+	
+	for (i = 0, codes = 1; i < length && codes <= 65536; i++) codes *= symbols;
+	if (codes > 65536) return NULL;
+	
+	dna->kmers = zoeRealloc(dna->kmers, (dna->kmer_sets +1) * sizeof(struct zoeKmers *));
+	k = zoeMalloc(sizeof(struct zoeKmers));
+	dna->kmers[dna->kmer_sets++] = k;
+	k->symbols = symbols;
+	k->length  = length;
+	k->code8   = NULL;
+	k->code16  = NULL;
+	if (codes <= 256) k->code8  = zoeMalloc((dna->length +1) * sizeof(unsigned char));
+	else              k->code16 = zoeMalloc((dna->length +1) * sizeof(unsigned short));
+	fill_kmers(dna, k);
+	return k;
+}
+
 #endif
@@ -60,14 +60,24 @@ Num  s5    s16
 
 \******************************************************************************/
 
+struct zoeKmers {
+	int              symbols;
+	int              length;
+	unsigned char  * code8;  /* LUT index of the s5 k-mer starting at each position, */
+	unsigned short * code16; /* in whichever of these is narrow enough, or NULL */
+};
+#define zoeKMER(k, i) ((k)->code8 ? (k)->code8[i] : (k)->code16[i])
+
 struct zoeDNA  {
-	coor_t   length;
-	char   * def;     /* definition */
-	char   * seq;     /* ascii sequence */
-	char   * s5;      /*  5 symbol numeric sequence */
-	char   * s16;     /* 15 symbol numeric sequence */
-	float    c5[5];   /* symbol counts */
-	float    f5[5];   /* symbol frequencies */
+	coor_t            length;
+	char            * def;     /* definition */
+	char            * seq;     /* ascii sequence */
+	char            * s5;      /*  5 symbol numeric sequence */
+	char            * s16;     /* 15 symbol numeric sequence */
+	float             c5[5];   /* symbol counts */
+	float             f5[5];   /* symbol frequencies */
+	struct zoeKmers** kmers;   /* see zoeKmerCodes, refilled when s5 changes */
+	int               kmer_sets;
 };
 typedef struct zoeDNA * zoeDNA;
 
@@ -91,5 +101,7 @@ zoeFeatureVec zoeORFs (const zoeDNA, strand_t);
 void          zoeWriteFeatureDNA(FILE *, const zoeFeature, const zoeDNA, coor_t);
 zoeDNA        zoeMakePaddedDNA (const zoeDNA, int);
 char*         zoeTranslateS5 (const char*, int, frame_t);
+const struct zoeKmers* zoeKmerCodes (zoeDNA, int, int);
+void          zoeDropKmerCodes (zoeDNA);
 
 #endif
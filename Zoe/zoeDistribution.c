@@ -148,4 +148,25 @@ score_t zoeScoreDistribution(const zoeDistribution dist, coor_t pos) {
 	return MIN_SCORE; /* shush compiler warning */
 }
 
+score_t zoeMaxDistribution(const zoeDistribution dist) {
+	int     i;
+	score_t max = MIN_SCORE;
+	
+	/* no score of the distribution is higher, MAX_SCORE if unknown */
+	switch (dist->type) {
+		case GEOMETRIC: /* decreasing when the mean is above 1 */
+			if (dist->param[0] <= 1) return MAX_SCORE;
+			return zoeScoreGeometric((double)dist->param[0],
+				(double)((dist->start > 1) ? dist->start : 1));
+		case CONSTANT:
+			return dist->param[0];
+		case DEFINED:
+			for (i = 0; i < dist->params; i++) {
+				if (dist->param[i] > max) max = dist->param[i];
+			}
+			return max;
+		default: return MAX_SCORE;
+	}
+}
+
 #endif
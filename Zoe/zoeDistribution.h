@@ -58,5 +58,6 @@ zoeDistribution zoeNewDistribution (zoeDistributionType, coor_t, coor_t, int, co
 zoeDistribution zoeReadDistribution (FILE *);
 void            zoeWriteDistribution (FILE *, const zoeDistribution);
 score_t         zoeScoreDistribution (const zoeDistribution, coor_t);
+score_t         zoeMaxDistribution (const zoeDistribution);
 
 #endif
@@ -142,4 +142,16 @@ score_t zoeScoreDuration(const zoeDuration dm, coor_t pos) {
 	return zoeScoreDistribution(dm->distribution[found], pos);
 }
 
+score_t zoeMaxDuration(const zoeDuration dm) {
+	int     i;
+	score_t score, max = MIN_SCORE;
+	
+	/* an upper bound of zoeScoreDuration at any length */
+	for (i = 0; i < dm->distributions; i++) {
+		score = zoeMaxDistribution(dm->distribution[i]);
+		if (score > max) max = score;
+	}
+	return max;
+}
+
 #endif
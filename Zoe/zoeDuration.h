@@ -49,5 +49,6 @@ zoeDuration zoeNewDuration (zoeLabel, int, const zoeDistribution *);
 zoeDuration zoeReadDuration (FILE *);
 void        zoeWriteDuration (FILE *, const zoeDuration);
 score_t     zoeScoreDuration (const zoeDuration, coor_t);
+score_t     zoeMaxDuration (const zoeDuration);
 
 #endif
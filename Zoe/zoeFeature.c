@@ -495,4 +495,34 @@ zoeFeatureVec zoeCopyFeatureVec (const zoeFeatureVec vec) {
 	return v;
 }
 
+/* zoeFeatureBuf stuff */
+
+void zoeDeleteFeatureBuf (zoeFeatureBuf buf) {
+	if (buf->elem) {
+		zoeFree(buf->elem);
+		buf->elem = NULL;
+	}
+	zoeFree(buf);
+	buf = NULL;
+}
+
+zoeFeatureBuf zoeNewFeatureBuf (void) {
+	zoeFeatureBuf buf = zoeMalloc(sizeof(struct zoeFeatureBuf));
+	buf->size  = 0;
+	buf->limit = 0;
+	buf->elem  = NULL;
+	return buf;
+}
+
+void zoePushFeatureBuf (zoeFeatureBuf buf, const zoeFeature f) {
+	if (buf->limit == buf->size) {
+		if (buf->limit == 0) buf->limit  = 16;
+		else                 buf->limit *= 2;
+		buf->elem = zoeRealloc(buf->elem, buf->limit * sizeof(struct zoeFeature));
+	}
+	buf->elem[buf->size] = *f;
+	buf->elem[buf->size].group = NULL;
+	buf->size++;
+}
+
 #endif
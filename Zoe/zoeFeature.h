@@ -104,6 +104,13 @@ struct zoeFeatureVec  {
 };
 typedef struct zoeFeatureVec * zoeFeatureVec;
 
+struct zoeFeatureBuf  {
+	struct zoeFeature * elem;   /* plain records, group is always NULL */
+	int                 size;   /* number of records, reset to 0 for reuse */
+	int                 limit;  /* number of records currently allocated */
+};
+typedef struct zoeFeatureBuf * zoeFeatureBuf;
+
 void       zoeDeleteFeature (zoeFeature);
 zoeFeature zoeNewFeature (zoeLabel, coor_t, coor_t, strand_t, score_t, frame_t, frame_t, frame_t, const char */*, zoeFeatureVec*/);
 zoeFeature zoeNewTriteFeature (zoeLabel, coor_t, coor_t, const char *);
@@ -129,5 +136,9 @@ zoeFeatureVec zoeNewFeatureVec (void);
 void          zoePushFeatureVec (zoeFeatureVec, const zoeFeature);
 zoeFeatureVec zoeCopyFeatureVec (const zoeFeatureVec);
 
+void          zoeDeleteFeatureBuf (zoeFeatureBuf);
+zoeFeatureBuf zoeNewFeatureBuf (void);
+void          zoePushFeatureBuf (zoeFeatureBuf, const zoeFeature);
+
 
 #endif
@@ -37,25 +37,29 @@ static const int PADDING = 48; /* as in trellis, should make it extern */
  PRIVATE FUNCTIONS
 \******************************************************************************/
 
-static zoeFeatureVec zoeMakeFeatures (const zoeFeatureFactory fac, coor_t pos) {
-	score_t       score;
-	zoeFeature    f;
-	zoeFeatureVec vec;
+static int zoeMakeFeatures (const zoeFeatureFactory fac, coor_t pos, zoeFeatureBuf buf) {
+	score_t           score;
+	struct zoeFeature f;
 
 	score = fac->scanner->score(fac->scanner, pos);
-	if (score == MIN_SCORE) return NULL;
+	if (score == MIN_SCORE) return 0;
 	
-	f = zoeNewFeature(fac->type, pos, pos, '+', score, 0, 0, 0, NULL/*, NULL*/);
-	vec = zoeNewFeatureVec();
-	zoePushFeatureVec(vec, f);
-	zoeDeleteFeature(f);
-	return vec;
+	f.label  = fac->type;
+	f.start  = pos;
+	f.end    = pos;
+	f.strand = '+';
+	f.score  = score;
+	f.inc5   = 0;
+	f.inc3   = 0;
+	f.frame  = 0;
+	f.group  = NULL;
+	zoePushFeatureBuf(buf, &f);
+	return 1;
 }
 
-static zoeFeatureVec zoeMakeRepeats (const zoeFeatureFactory fac, coor_t pos) {
-	coor_t        i, start, end;
-	zoeFeature    f;    /* = zoeNewFeature(None, 0, 0, '+', 0, 0, 0, 0, NULL);*/
-	zoeFeatureVec fvec; /* = zoeNewFeatureVec(); */
+static int zoeMakeRepeats (const zoeFeatureFactory fac, coor_t pos, zoeFeatureBuf buf) {
+	coor_t            i, start, end;
+	struct zoeFeature f;
 
 	/* does a repeat end here? */
 	if (fac->dna->s5[pos] == 4) {
@@ -64,10 +68,10 @@ static zoeFeatureVec zoeMakeRepeats (const zoeFeatureFactory fac, coor_t pos) {
 		} else if (fac->dna->s5[pos +1] != 4) {
 			end = pos;
 		} else {
-			return NULL;
+			return 0;
 		}
 	} else {
-		return NULL;
+		return 0;
 	}
 		
 	/* find repeat start */
@@ -79,27 +83,32 @@ static zoeFeatureVec zoeMakeRepeats (const zoeFeatureFactory fac, coor_t pos) {
 	start = i;
 	
 	/* min length filtering */
-	if (end - start + 1 < fac->length) return NULL;
+	if (end - start + 1 < fac->length) return 0;
 	
 	/* make a repeat */
-	fvec = zoeNewFeatureVec();
-	f = zoeNewFeature(Repeat, start, end, '=', 0, 0, 0, 0, NULL/*, NULL*/);
-	f->score = fac->scanner->scoref(fac->scanner, f);
-	zoePushFeatureVec(fvec, f);	
-	zoeDeleteFeature(f);
-	return fvec;
+	f.label  = Repeat;
+	f.start  = start;
+	f.end    = end;
+	f.strand = '=';
+	f.score  = 0;
+	f.inc5   = 0;
+	f.inc3   = 0;
+	f.frame  = 0;
+	f.group  = NULL;
+	f.score  = fac->scanner->scoref(fac->scanner, &f);
+	zoePushFeatureBuf(buf, &f);
+	return 1;
 }
 
-static zoeFeatureVec zoeMakeExons (const zoeFeatureFactory fac, coor_t pos) {
-	int           i, frame = -1, inc5, inc3, begin, end, length;
-	zoeFeature    exon = zoeNewFeature(None, 0, 0, '+', 0, 0, 0, 0, NULL/*, NULL*/);
-	zoeFeature    e = NULL;
-	zoeFeatureVec vec = zoeNewFeatureVec();
-	/*int j;*/
+static int zoeMakeExons (const zoeFeatureFactory fac, coor_t pos, zoeFeatureBuf buf) {
+	int               i, frame = -1, inc5, inc3, begin, end, length, first;
+	struct zoeFeature exon;
+	zoeFeature        e = NULL;
 	
 	/* invariant */
-	exon->group  = NULL;
-	exon->strand = '+';
+	exon.group  = NULL;
+	exon.strand = '+';
+	first = buf->size;
 	
 	/* Esngl */
 	if (fac->stop[pos] != MIN_SCORE) {
@@ -108,15 +117,14 @@ static zoeFeatureVec zoeMakeExons (const zoeFeatureFactory fac, coor_t pos) {
 		begin = fac->fstop[end];
 		for (i = begin; i < end; i += 3) {
 			if (fac->start[i] == MIN_SCORE) continue;
-			exon->label = Esngl;
-			exon->start = i;
-			exon->end   = pos -1;
-			exon->score = fac->start[i] + fac->stop[pos];
-			exon->inc5   = 0;
-			exon->inc3   = 0;
-			exon->frame = frame;
-			exon->group = NULL;
-			zoePushFeatureVec(vec, exon);
+			exon.label = Esngl;
+			exon.start = i;
+			exon.end   = pos -1;
+			exon.score = fac->start[i] + fac->stop[pos];
+			exon.inc5  = 0;
+			exon.inc3  = 0;
+			exon.frame = frame;
+			zoePushFeatureBuf(buf, &exon);
 		}
 	}
 	
@@ -127,14 +135,14 @@ static zoeFeatureVec zoeMakeExons (const zoeFeatureFactory fac, coor_t pos) {
 		begin = fac->fstop[end];
 		for (i = begin; i < end; i++) {
 			if (fac->acc[i] == MIN_SCORE) continue;
-			exon->label = Eterm;
-			exon->start = i + 1;
-			exon->end   = pos -1;
-			exon->score = fac->acc[i] + fac->stop[pos];
-			exon->inc5   = (exon->end - exon->start + 1) % 3;
-			exon->inc3   = 0;
-			exon->frame = frame % 3;
-			zoePushFeatureVec(vec, exon);
+			exon.label = Eterm;
+			exon.start = i + 1;
+			exon.end   = pos -1;
+			exon.score = fac->acc[i] + fac->stop[pos];
+			exon.inc5  = (exon.end - exon.start + 1) % 3;
+			exon.inc3  = 0;
+			exon.frame = frame % 3;
+			zoePushFeatureBuf(buf, &exon);
 		}
 	}
 	
@@ -150,14 +158,14 @@ static zoeFeatureVec zoeMakeExons (const zoeFeatureFactory fac, coor_t pos) {
 			
 			for (i = begin; i < end; i += 3) {
 				if (fac->start[i] == MIN_SCORE) continue;
-				exon->label = Einit;
-				exon->start = i;
-				exon->end   = pos - 1;
-				exon->score = fac->start[i] + fac->don[pos];
-				exon->inc5   = 0;
-				exon->inc3   = inc3;
-				exon->frame = frame;
-				zoePushFeatureVec(vec, exon);
+				exon.label = Einit;
+				exon.start = i;
+				exon.end   = pos - 1;
+				exon.score = fac->start[i] + fac->don[pos];
+				exon.inc5  = 0;
+				exon.inc3  = inc3;
+				exon.frame = frame;
+				zoePushFeatureBuf(buf, &exon);
 			}
 		}
 	}
@@ -172,21 +180,21 @@ static zoeFeatureVec zoeMakeExons (const zoeFeatureFactory fac, coor_t pos) {
 				if (fac->acc[i] == MIN_SCORE) continue;
 				length = pos -1 - i;
 				inc5 = (length - inc3) % 3;
-				exon->label  = Exon;
-				exon->start  = i + 1;
-				exon->end    = pos - 1;
-				exon->score  = fac->acc[i] + fac->don[pos];
-				exon->inc5    = inc5;
-				exon->inc3    = inc3;
-				exon->frame  = frame;
-				zoePushFeatureVec(vec, exon);
+				exon.label  = Exon;
+				exon.start  = i + 1;
+				exon.end    = pos - 1;
+				exon.score  = fac->acc[i] + fac->don[pos];
+				exon.inc5   = inc5;
+				exon.inc3   = inc3;
+				exon.frame  = frame;
+				zoePushFeatureBuf(buf, &exon);
 			}
 		}
 	}
 			
 	/* add coding score */
-	for (i = 0; i < vec->size; i++) {
-		e = vec->elem[i];
+	for (i = first; i < buf->size; i++) {
+		e = &buf->elem[i];
 		
 		/* convert exon frame to cds[frame] -  I know, it looks weird, trust me... */
 		switch (e->frame) {
@@ -212,29 +220,53 @@ static zoeFeatureVec zoeMakeExons (const zoeFeatureFactory fac, coor_t pos) {
 				      - fac->cds[frame][e->start +3]; /* changed +9 to +3 */
 		}
 	}
-		
-	zoeDeleteFeature(exon);
 	
-	if (vec->size) {
-		return vec;
-	} else {
-		zoeDeleteFeatureVec(vec);
-		return NULL;
-	}
+	return buf->size - first;
 }
 
-static zoeFeatureVec zoeMakeOpenReadingFrames (const zoeFeatureFactory fac, coor_t pos) {
-	zoeFeatureVec vec;
-	zoeFeature    orf;
-	char          key[16];
+static int zoeMakeOpenReadingFrames (const zoeFeatureFactory fac, coor_t pos, zoeFeatureBuf buf) {
+	zoeFeature orf;
+	char       key[16];
 	
 	sprintf(key, "%d", pos);
 	orf = zoeGetHash(fac->hash, key);
-	if (orf == NULL) return NULL;
+	if (orf == NULL) return 0;
+	
+	zoePushFeatureBuf(buf, orf);
+	return 1;
+}
+
+/* mark functions flag every position where create may emit a feature */
+
+static void zoeMarkFeatures (const zoeFeatureFactory fac, char * mark) {
+	coor_t i;
+	
+	for (i = 0; i < fac->dna->length; i++) {
+		if (fac->scanner->score(fac->scanner, i) != MIN_SCORE) mark[i] = 1;
+	}
+}
+
+static void zoeMarkRepeats (const zoeFeatureFactory fac, char * mark) {
+	coor_t i;
+	
+	for (i = 0; i < fac->dna->length; i++) {
+		if (fac->dna->s5[i] != 4) continue;
+		if (i == fac->dna->length -1 || fac->dna->s5[i+1] != 4) mark[i] = 1;
+	}
+}
+
+static void zoeMarkExons (const zoeFeatureFactory fac, char * mark) {
+	coor_t i;
+	
+	for (i = 0; i < fac->dna->length; i++) {
+		if (fac->stop[i] != MIN_SCORE || fac->don[i] != MIN_SCORE) mark[i] = 1;
+	}
+}
+
+static void zoeMarkOpenReadingFrames (const zoeFeatureFactory fac, char * mark) {
+	int i;
 	
-	vec = zoeNewFeatureVec();
-	zoePushFeatureVec(vec, orf);
-	return vec;
+	for (i = 0; i < fac->orfs->size; i++) mark[fac->orfs->elem[i]->end] = 1;
 }
 
 /******************************************************************************\
@@ -278,47 +310,79 @@ zoeFeatureFactory zoeNewEFactory (
 	zoeScanner start_scan,
 	zoeScanner stop_scan)
 {
+	zoeDNA            dna = cds_scan->dna;
+	zoeFeatureFactory factory = zoeMalloc(sizeof(struct zoeFeatureFactory));
+
+	/* allocate storage for factory attributes */
+	factory->cds[0] = zoeMalloc(dna->length * sizeof(score_t));
+	factory->cds[1] = zoeMalloc(dna->length * sizeof(score_t));
+	factory->cds[2] = zoeMalloc(dna->length * sizeof(score_t));
+	factory->acc    = zoeMalloc(dna->length * sizeof(score_t));	
+	factory->don    = zoeMalloc(dna->length * sizeof(score_t));
+	factory->start  = zoeMalloc(dna->length * sizeof(score_t));
+	factory->stop   = zoeMalloc(dna->length * sizeof(score_t));
+	factory->fstop  = zoeMalloc(dna->length * sizeof(int));
+	
+	/* set factory attributes ----------------------------------------------- */
+	factory->create  = zoeMakeExons;
+	factory->mark    = zoeMarkExons;
+	factory->type    = Exon;
+	factory->dna     = dna;
+	factory->offset  = cds_scan->subscanner[0]->model->focus;
+		
+	/* this stuff isn't used by an EFactory */
+	factory->length  = 0;
+	factory->score   = 0;
+	factory->scanner = NULL;
+	factory->orfs    = NULL;
+	factory->hash    = NULL;
+	
+	zoeRescoreEFactory(factory, cds_scan, accpt_scan, donor_scan, start_scan,
+		stop_scan, 0);
+	
+	return factory;
+}
 
-	score_t         * cds[3];
-	score_t         * acc;
-	score_t         * don;
-	score_t         * start;
-	score_t         * stop;
+void zoeRescoreEFactory (
+	zoeFeatureFactory factory,
+	zoeScanner        cds_scan,
+	zoeScanner        accpt_scan,
+	zoeScanner        donor_scan,
+	zoeScanner        start_scan,
+	zoeScanner        stop_scan,
+	coor_t            from)
+{
+	score_t        ** cds = factory->cds;
+	score_t         * acc = factory->acc;
+	score_t         * don = factory->don;
+	score_t         * start = factory->start;
+	score_t         * stop = factory->stop;
+	int             * fstop = factory->fstop;
 	int               f0, f1, f2;
-	int             * fstop;	
 	coor_t            i;
-	zoeDNA            dna = cds_scan->dna;
-	zoeFeatureFactory factory = zoeMalloc(sizeof(struct zoeFeatureFactory));
+	zoeDNA            dna = factory->dna;
 		
 	/* cds frame-specific scanners */
 	zoeScanner cscan[3];
 	cscan[0] = cds_scan->subscanner[0];
 	cscan[1] = cds_scan->subscanner[1];
 	cscan[2] = cds_scan->subscanner[2];
-
-	/* allocate storage for factory attributes */
-	cds[0] = zoeMalloc(dna->length * sizeof(score_t));
-	cds[1] = zoeMalloc(dna->length * sizeof(score_t));
-	cds[2] = zoeMalloc(dna->length * sizeof(score_t));
-	acc    = zoeMalloc(dna->length * sizeof(score_t));	
-	don    = zoeMalloc(dna->length * sizeof(score_t));
-	start  = zoeMalloc(dna->length * sizeof(score_t));
-	stop   = zoeMalloc(dna->length * sizeof(score_t));
-	fstop  = zoeMalloc(dna->length * sizeof(int));
+	
+	/* everything before from is kept, the sums continue from there */
 	
 	/* compute feature positions -------------------------------------------- */
-	for (i = 0; i < dna->length; i++) {
-		acc[i]   = accpt_scan->score(accpt_scan, i);
-		don[i]   = donor_scan->score(donor_scan, i);
-		start[i] = start_scan->score(start_scan, i);
-		stop[i]  = stop_scan->score(stop_scan, i);
-	}
+	zoeScoreTrack(accpt_scan, from, dna->length, acc);
+	zoeScoreTrack(donor_scan, from, dna->length, don);
+	zoeScoreTrack(start_scan, from, dna->length, start);
+	zoeScoreTrack(stop_scan,  from, dna->length, stop);
 	
 	/* compute CDS scores in 3 frames --------------------------------------- */
-	cds[0][0] = 0;
-	cds[1][0] = 0;
-	cds[2][0] = 0;
-	for (i = 1; i < dna->length; i++) {
+	if (from == 0) {
+		cds[0][0] = 0;
+		cds[1][0] = 0;
+		cds[2][0] = 0;
+	}
+	for (i = (from > 1) ? from : 1; i < dna->length; i++) {
 		f0 = (i - 1) % 3;
 		f1 = (i + 0) % 3;
 		f2 = (i + 1) % 3;
@@ -335,40 +399,19 @@ zoeFeatureFactory zoeNewEFactory (
 	}
 	
 	/* positions of stop codons in each frame  ------------------------------ */	
-	fstop[0] = 0;
-	fstop[1] = 1;
-	fstop[2] = 2;
+	if (from < 3) {
+		fstop[0] = 0;
+		fstop[1] = 1;
+		fstop[2] = 2;
+	}
 	
-	for (i = 3; i < dna->length; i++) {
+	for (i = (from > 3) ? from : 3; i < dna->length; i++) {
 		if (stop[i] != MIN_SCORE) {
 			fstop[i] = i;
 		} else {
 			fstop[i] = fstop[i-3];
 		}
 	}
-
-	/* set factory attributes ----------------------------------------------- */
-	factory->create  = zoeMakeExons;
-	factory->type    = Exon;
-	factory->dna     = dna;
-	factory->cds[0]  = cds[0];
-	factory->cds[1]  = cds[1];
-	factory->cds[2]  = cds[2];
-	factory->acc     = acc;
-	factory->don     = don;
-	factory->start   = start;
-	factory->stop    = stop;
-	factory->fstop   = fstop;
-	factory->offset  = cscan[0]->model->focus;
-		
-	/* this stuff isn't used by an EFactory */
-	factory->length  = 0;
-	factory->score   = 0;
-	factory->scanner = NULL;
-	factory->orfs    = NULL;
-	factory->hash    = NULL;
-	
-	return factory;
 }
 
 zoeFeatureFactory zoeNewXFactory  (
@@ -380,16 +423,43 @@ zoeFeatureFactory zoeNewXFactory  (
 	coor_t     min_length,
 	score_t    min_score) {
 
-	zoeFeatureFactory factory = zoeMalloc(sizeof(struct zoeFeatureFactory));
+	zoeFeatureFactory factory;
 	zoeFeatureFactory efac;
-	zoeFeatureVec     exons;
+	zoeScanner        cs, as, ds, ms, ss;
+	
+	cs = zoeNewScanner(cds_scan->anti, cds_scan->dna, cds_scan->model);
+	as = zoeNewScanner(cds_scan->anti, cds_scan->dna, accpt_scan->model);
+	ds = zoeNewScanner(cds_scan->anti, cds_scan->dna, donor_scan->model);
+	ms = zoeNewScanner(cds_scan->anti, cds_scan->dna, start_scan->model);
+	ss = zoeNewScanner(cds_scan->anti, cds_scan->dna, stop_scan->model);
+	
+	efac = zoeNewEFactory(cs, as, ds, ms, ss);
+	factory = zoeNewXFactoryFromEFactory(efac, min_length, min_score);
+	
+	zoeDeleteScanner(cs);
+	zoeDeleteScanner(as);
+	zoeDeleteScanner(ds);
+	zoeDeleteScanner(ms);
+	zoeDeleteScanner(ss);
+	zoeDeleteFeatureFactory(efac);
+		
+	return factory;
+}
+
+zoeFeatureFactory zoeNewXFactoryFromEFactory (
+	const zoeFeatureFactory efac, /* exons of the opposite strand */
+	coor_t                  min_length,
+	score_t                 min_score) {
+
+	zoeFeatureFactory factory = zoeMalloc(sizeof(struct zoeFeatureFactory));
+	zoeFeatureBuf     exons;
 	zoeFeature        exon, max_exon;
 	score_t           max_score;
-	zoeScanner        cs, as, ds, ms, ss;
 	int               i, j, length;
 	char              key[16];
 	
 	factory->create  = zoeMakeOpenReadingFrames;
+	factory->mark    = zoeMarkOpenReadingFrames;
 	factory->type    = ORF;
 	factory->length  = min_length;
 	factory->score   = min_score;
@@ -406,25 +476,18 @@ zoeFeatureFactory zoeNewXFactory  (
 	factory->stop      = NULL;
 	factory->fstop     = NULL;
 	
-	cs = zoeNewScanner(cds_scan->anti, cds_scan->dna, cds_scan->model);
-	as = zoeNewScanner(cds_scan->anti, cds_scan->dna, accpt_scan->model);
-	ds = zoeNewScanner(cds_scan->anti, cds_scan->dna, donor_scan->model);
-	ms = zoeNewScanner(cds_scan->anti, cds_scan->dna, start_scan->model);
-	ss = zoeNewScanner(cds_scan->anti, cds_scan->dna, stop_scan->model);
-	
-	efac = zoeNewEFactory(cs, as, ds, ms, ss);
-		
 	/* XFactory precomputes all ORFs */
 	factory->orfs = zoeNewFeatureVec();
-	for (i = PADDING; i < cds_scan->dna->length -PADDING; i++) {
-		exons = efac->create(efac, i);
-		if (exons == NULL) continue;
+	exons = zoeNewFeatureBuf();
+	for (i = PADDING; i < efac->dna->length -PADDING; i++) {
+		exons->size = 0;
+		if (efac->create(efac, i, exons) == 0) continue;
 		
 		/* find maximum-scoring exon at each position */
 		max_score = MIN_SCORE;
 		max_exon = NULL;
 		for (j = 0; j < exons->size; j++) {
-			exon = exons->elem[j];
+			exon = &exons->elem[j];
 			if (exon->score < min_score) continue;
 			length = exon->end - exon->start + 1;
 			if (length < min_length) continue;
@@ -436,12 +499,11 @@ zoeFeatureFactory zoeNewXFactory  (
 		
 		if (max_score != MIN_SCORE) {
 			max_exon->label = ORF;
-			zoeAntiFeature(max_exon, cds_scan->dna->length);
+			zoeAntiFeature(max_exon, efac->dna->length);
 			zoePushFeatureVec(factory->orfs, max_exon);
 		}
-		
-		zoeDeleteFeatureVec(exons);
 	}
+	zoeDeleteFeatureBuf(exons);
 	
 	/* create a lookup */
 	factory->hash = zoeNewHash();
@@ -451,13 +513,6 @@ zoeFeatureFactory zoeNewXFactory  (
 		zoeSetHash(factory->hash, key, exon);
 	}
 	
-	zoeDeleteScanner(cs);
-	zoeDeleteScanner(as);
-	zoeDeleteScanner(ds);
-	zoeDeleteScanner(ms);
-	zoeDeleteScanner(ss);
-	zoeDeleteFeatureFactory(efac);
-		
 	return factory;
 }
 
@@ -467,6 +522,7 @@ zoeFeatureFactory zoeNewSFactory(
 {
 	zoeFeatureFactory factory = zoeMalloc(sizeof(struct zoeFeatureFactory));
 	factory->create  = zoeMakeFeatures;
+	factory->mark    = zoeMarkFeatures;
 	factory->type    = type;
 	factory->dna     = scanner->dna;
 	factory->scanner = scanner;
@@ -494,6 +550,7 @@ zoeFeatureFactory zoeNewRFactory(
 {
 	zoeFeatureFactory factory = zoeMalloc(sizeof(struct zoeFeatureFactory));
 	factory->create  = zoeMakeRepeats;
+	factory->mark    = zoeMarkRepeats;
 	factory->type    = Repeat;
 	factory->dna     = scanner->dna;
 	factory->length  = length;
@@ -41,7 +41,8 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 
 struct zoeFeatureFactory  {
 	/* used by all factories */
-	zoeFeatureVec (* create)(struct zoeFeatureFactory *, coor_t);
+	int (* create)(struct zoeFeatureFactory *, coor_t, zoeFeatureBuf); /* appends, returns count */
+	void (* mark)(struct zoeFeatureFactory *, char *); /* flags positions create may use */
 	zoeLabel         type;
 	zoeDNA           dna;
 	
@@ -70,8 +71,10 @@ typedef struct zoeFeatureFactory * zoeFeatureFactory;
 
 void              zoeDeleteFeatureFactory (zoeFeatureFactory);
 zoeFeatureFactory zoeNewEFactory (zoeScanner, zoeScanner, zoeScanner, zoeScanner, zoeScanner);
+void              zoeRescoreEFactory (zoeFeatureFactory, zoeScanner, zoeScanner, zoeScanner, zoeScanner, zoeScanner, coor_t);
 zoeFeatureFactory zoeNewOFactory (zoeScanner, coor_t, score_t, strand_t);
 zoeFeatureFactory zoeNewXFactory (zoeScanner, zoeScanner, zoeScanner, zoeScanner, zoeScanner, coor_t, score_t);
+zoeFeatureFactory zoeNewXFactoryFromEFactory (const zoeFeatureFactory, coor_t, score_t);
 zoeFeatureFactory zoeNewRFactory (zoeScanner, coor_t);
 zoeFeatureFactory zoeNewSFactory (zoeScanner, zoeLabel);
 
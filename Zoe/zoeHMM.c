@@ -67,10 +67,11 @@ static int tag_error (FILE * stream, const char * tag) {
 }
 
 static void zoeMapHMM (zoeHMM hmm) {
-	int      i, j, k;
-	zoeLabel label, from, to;
-	score_t  score;
-	score_t  null_score;
+	int              i, j, k;
+	zoeLabel         label, from, to;
+	score_t          score;
+	score_t          null_score;
+	struct zoeJump * jump;
 	
 	/* smap (state map) */
 	for (i = 0; i < zoeLABELS; i++) hmm->smap[i] = NULL;
@@ -237,6 +238,40 @@ static void zoeMapHMM (zoeHMM hmm) {
 		}
 	}
 	
+	/* compiled topology: the jmap arrows in the order the decoder visits them */
+	hmm->internals = 0;
+	for (i = 0; i < zoeLABELS; i++) {
+		if (hmm->smap[i] == NULL || hmm->smap[i]->type != INTERNAL) continue;
+		hmm->internal[hmm->internals++] = i;
+	}
+	hmm->jumps = 0;
+	for (i = 0; i < zoeLABELS; i++) {
+		for (j = 0; j < zoeLABELS; j++) {
+			if (hmm->jmap[i][j]) hmm->jumps += hmm->jmap[i][j]->size;
+		}
+	}
+	hmm->jump = zoeMalloc((hmm->jumps +1) * sizeof(struct zoeJump));
+	hmm->jumps = 0;
+	for (i = 0; i < zoeLABELS; i++) {
+		hmm->jump_at[i] = hmm->jumps;
+		for (j = 0; j < zoeLABELS; j++) {
+			if (hmm->jmap[i][j] == NULL) continue;
+			for (k = 0; k < hmm->jmap[i][j]->size; k++) {
+				if ((j == Repeat || j == ORF || j == CNS) && hmm->jmap[i][j]->elem[k] != i)
+					continue; /* shuttles return to the state they left */
+				jump = &hmm->jump[hmm->jumps++];
+				jump->int_state = i;
+				jump->ext_state = j;
+				jump->pre_state = hmm->jmap[i][j]->elem[k];
+				jump->t1score   = hmm->tmap[j][i];
+				jump->t2score   = hmm->tmap[jump->pre_state][j];
+				jump->exonic    = (j == Einit || j == Eterm || j == Exon || j == Esngl);
+				jump->shuttle   = (j == Repeat || j == ORF || j == CNS);
+			}
+		}
+	}
+	hmm->jump_at[zoeLABELS] = hmm->jumps;
+	
 	/* cmap */
 	for (i = 0; i < zoeLABELS; i++) {
 		if (hmm->smap[i] == NULL) continue;
@@ -343,6 +378,8 @@ void zoeDeleteHMM (zoeHMM hmm) {
 		hmm->model = NULL;
 	}
 			
+	if (hmm->jump) zoeFree(hmm->jump);
+	
 	/* jmap only mapped needed to free */
 	for (i = 0; i < zoeLABELS; i++) {
 		for (j = 0; j < zoeLABELS; j++) {
@@ -369,6 +406,9 @@ zoeHMM zoeNewHMM (void) {
 	hmm->duration    = NULL;
 	hmm->model       = NULL;
 	hmm->phasepref   = NULL;
+	hmm->jump        = NULL;
+	hmm->jumps       = 0;
+	hmm->internals   = 0;
 	
 	for (i = 0; i < zoeLABELS; i++) {
 		hmm->dmap[i] = NULL;
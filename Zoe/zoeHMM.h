@@ -41,6 +41,16 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 #include "zoeTransition.h"
 #include "zoeTools.h"
 
+struct zoeJump {
+	zoeLabel int_state; /* internal state entered */
+	zoeLabel ext_state; /* external state jumped through */
+	zoeLabel pre_state; /* internal state left */
+	score_t  t1score;   /* tmap[ext_state][int_state] */
+	score_t  t2score;   /* tmap[pre_state][ext_state] */
+	int      exonic;    /* ext_state is Einit, Eterm, Exon or Esngl */
+	int      shuttle;   /* ext_state is Repeat, ORF or CNS */
+};
+
 struct zoeHMM  {
 	/* general attributes */
 	char * name;        /* completely arbitrary */
@@ -66,6 +76,13 @@ struct zoeHMM  {
 	score_t     xmap[zoeLABELS];            /* geometric extension score */
 	score_t     tmap[zoeLABELS][zoeLABELS]; /* transition score */
 	coor_t      cmap[zoeLABELS];            /* coordinate adjustments */
+	
+	/* compiled topology */
+	zoeLabel         internal[zoeLABELS];   /* internal states in label order */
+	int              internals;
+	struct zoeJump * jump;                  /* jmap arrows by int_state, ext_state */
+	int              jumps;
+	int              jump_at[zoeLABELS +1]; /* first jump of each int_state */
 };
 typedef struct zoeHMM * zoeHMM;
 
@@ -54,6 +54,22 @@ score_t zoeFloat2Score (double x) {
 }
 double  zoeScore2Float (score_t s)  {return pow((double)2, ((double)s));}
 
+fixed_t zoeScore2Fixed (score_t s) {
+	double x;
+	
+	/* nearest 1/FIXED_SCALE bit; below MIN_FIXED/2 is -inf, see zoeTrellis */
+	if (s == MIN_SCORE) return MIN_FIXED;
+	x = floor((double)s * FIXED_SCALE + 0.5);
+	if (x <= MIN_FIXED / 2) return MIN_FIXED;
+	if (x >= MAX_FIXED)     return MAX_FIXED;
+	return (fixed_t)x;
+}
+
+score_t zoeFixed2Score (fixed_t f) {
+	if (f == MIN_FIXED) return MIN_SCORE;
+	return (score_t)((double)f / FIXED_SCALE);
+}
+
 double zoeLnFactorial (int n) {
 	double f;
 	
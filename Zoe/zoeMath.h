@@ -34,6 +34,8 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 
 score_t zoeFloat2Score (double);
 double  zoeScore2Float (score_t);
+fixed_t zoeScore2Fixed (score_t);
+score_t zoeFixed2Score (fixed_t);
 double  zoeLog2 (double);
 double  zoeLnFactorial (int);
 double  zoeDivide (double, double);
@@ -31,6 +31,13 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 
 #include "zoeScanner.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#define TRACK_BATCH 512 /* positions zoeScoreTrack collects at a time */
+#define SDT_COLUMNS 4   /* most columns compiled into an SDT table */
+
 /******************************************************************************\
  PRIVATE FUNCTIONS
 \******************************************************************************/
@@ -58,41 +65,66 @@ static char seq2sig (int c) {
 	}
 }
 
-static int zoeSDTlookup (zoeScanner scanner, coor_t mfocus) {
-	char c;
-	int i, j, found, scanner_number = -1; /* impossible value */
+static int sdt_match (const zoeScanner scanner, const char * s16) {
+	int i, j;
 	
-	if (mfocus >= 0) {
-		for (i = 0; i < scanner->model->submodels; i++) {
-			found = 1;
-			for (j = 0; j < scanner->model->length; j++) {
-				if (scanner->subscanner[i]->sig[j] == 15) continue;
-				c = scanner->dna->s16[j + mfocus] | scanner->subscanner[i]->sig[j];
-				if (c != scanner->subscanner[i]->sig[j]) {
-					found = 0;
-					break;
-				}
-			}
-			if (found) {scanner_number = i; break;}
+	/* first submodel whose signature covers each base, -1 if none */
+	for (i = 0; i < scanner->model->submodels; i++) {
+		for (j = 0; j < scanner->model->length; j++) {
+			if (scanner->subscanner[i]->sig[j] == 15) continue;
+			if ((s16[j] | scanner->subscanner[i]->sig[j]) != scanner->subscanner[i]->sig[j]) break;
 		}
-		
-	} else {
-		/* reposition mfocus */
-		mfocus = scanner->dna->length -1 + mfocus;
+		if (j == scanner->model->length) return i;
+	}
+	return -1;
+}
+
+static void compile_sdt (zoeScanner scanner) {
+	int    i, j, key, keys;
+	char * s16;
+	
+	/*
+		Only the columns where some signature is not N decide the submodel.
+		With a few of them, every combination of s16 symbols there is
+		matched once, and zoeSDTlookup reads the answer from a table.
+	*/
+	scanner->column  = zoeMalloc(scanner->model->length * sizeof(int));
+	scanner->columns = 0;
+	for (j = 0; j < scanner->model->length; j++) {
 		for (i = 0; i < scanner->model->submodels; i++) {
-			found = 1;
-			for (j = 0; j < scanner->model->length; j++) {
-				if (scanner->subscanner[i]->sig[j] == 15) continue;
-				/* use scanner->anti rather than scanner->dna */
-				c = scanner->anti->s16[j + mfocus] | scanner->subscanner[i]->sig[j];
-				if (c != scanner->subscanner[i]->sig[j]) {
-					found = 0;
-					break;
-				}
+			if (scanner->subscanner[i]->sig[j] != 15) {
+				scanner->column[scanner->columns++] = j;
+				break;
 			}
-			if (found) {scanner_number = i; break;}
 		}
 	}
+	if (scanner->columns > SDT_COLUMNS) return;
+	
+	keys = 1 << (4 * scanner->columns);
+	scanner->node = zoeMalloc(keys * sizeof(int));
+	s16 = zoeMalloc(scanner->model->length);
+	for (j = 0; j < scanner->model->length; j++) s16[j] = 15;
+	for (key = 0; key < keys; key++) {
+		for (i = 0; i < scanner->columns; i++) s16[scanner->column[i]] = (key >> (4 * i)) & 15;
+		scanner->node[key] = sdt_match(scanner, s16);
+	}
+	zoeFree(s16);
+}
+
+static int zoeSDTlookup (zoeScanner scanner, coor_t mfocus) {
+	int          i, key, scanner_number;
+	const char * s16;
+	
+	/* negative mfocus is repositioned on scanner->anti */
+	s16 = (mfocus >= 0) ? scanner->dna->s16 + mfocus
+	                    : scanner->anti->s16 + scanner->dna->length -1 + mfocus;
+	if (scanner->node) {
+		key = 0;
+		for (i = 0; i < scanner->columns; i++) key |= s16[scanner->column[i]] << (4 * i);
+		scanner_number = scanner->node[key];
+	} else {
+		scanner_number = sdt_match(scanner, s16);
+	}
 
 	if (scanner_number == -1) zoeExit("no scanner found? zoeCountSDT");
 	return scanner_number;
@@ -136,6 +168,46 @@ static score_t zoeScoreWMM (const zoeScanner scanner, coor_t pos) {
 	return score;
 }
 
+static void wmm_batch (const zoeScanner scanner, const coor_t * pos, int n, score_t * out) {
+	int             k = 0;
+#if defined(__SSE__)
+	int             i;
+	int             length  = scanner->model->length;
+	int             symbols = scanner->model->symbols;
+	const score_t * data    = scanner->model->data;
+	const char    * s5      = scanner->dna->s5 - scanner->model->focus;
+	const char    * a, * b, * c, * d;
+	const score_t * row;
+	__m128          min, adj, v, sum, bad;
+	
+	/*
+		zoeScoreWMM at 4 positions per step, all inside the scoring range
+		and without user scores. Each lane adds its columns in the same
+		order, so the sums are the scalar ones; a lane that met MIN_SCORE
+		is MIN_SCORE, as the early exit makes it.
+	*/
+	min = _mm_set1_ps(MIN_SCORE);
+	adj = _mm_set1_ps(scanner->model->score);
+	for (; k + 4 <= n; k += 4) {
+		a = s5 + pos[k];
+		b = s5 + pos[k+1];
+		c = s5 + pos[k+2];
+		d = s5 + pos[k+3];
+		sum = _mm_setzero_ps();
+		bad = _mm_setzero_ps();
+		for (i = 0; i < length; i++) {
+			row = data + i * symbols;
+			v   = _mm_set_ps(row[(int)d[i]], row[(int)c[i]], row[(int)b[i]], row[(int)a[i]]);
+			bad = _mm_or_ps(bad, _mm_cmpeq_ps(v, min));
+			sum = _mm_add_ps(sum, v);
+		}
+		sum = _mm_add_ps(sum, adj);
+		_mm_storeu_ps(out + k, _mm_or_ps(_mm_and_ps(bad, min), _mm_andnot_ps(bad, sum)));
+	}
+#endif
+	for (; k < n; k++) out[k] = zoeScoreWMM(scanner, pos[k]);
+}
+
 static score_t zoeScoreLUT (const zoeScanner scanner, coor_t pos) {
 	coor_t i, p, index, mfocus;
 	
@@ -152,12 +224,14 @@ static score_t zoeScoreLUT (const zoeScanner scanner, coor_t pos) {
 	index = 0;
 	if (pos >= 0) {
 		mfocus = pos - scanner->model->focus;
+		if (scanner->code) return scanner->model->data[zoeKMER(scanner->code, mfocus)];
 		for (i = 0; i < scanner->model->length; i++) {
 			p = zoePOWER[scanner->model->symbols][scanner->model->length -i -1];
 			index += (p * scanner->dna->s5[i + mfocus]);
 		}
 	} else {
 		mfocus = scanner->dna->length -1 + pos - scanner->model->focus;
+		if (scanner->acode) return scanner->model->data[zoeKMER(scanner->acode, mfocus)];
 		for (i = 0; i < scanner->model->length; i++) {
 			p = zoePOWER[scanner->model->symbols][scanner->model->length -i -1];
 			/* use anti instead of dna */
@@ -167,10 +241,44 @@ static score_t zoeScoreLUT (const zoeScanner scanner, coor_t pos) {
 	return scanner->model->data[index];	
 }
 
+static void lut_track (const zoeScanner scanner, coor_t from, coor_t to, score_t * track) {
+	coor_t p, m, index = 0, top = 1;
+	int    i, fresh = 1;
+	zoeModel model = scanner->model;
+	
+	/* zoeScoreLUT along from..to-1, the index rolled as zoeKmerCodes does */
+	for (i = 1; i < model->length; i++) top *= model->symbols;
+	for (p = from; p < to; p++) {
+		if (scanner->uscore && scanner->uscore[p] != MIN_SCORE) {
+			track[p] = scanner->uscore[p];
+			fresh = 1;
+			continue;
+		}
+		if (p < scanner->min_pos || p > scanner->max_pos) {
+			track[p] = MIN_SCORE;
+			fresh = 1;
+			continue;
+		}
+		m = p - model->focus;
+		if (fresh) {
+			for (i = 0, index = 0; i < model->length; i++) {
+				index = index * model->symbols + scanner->dna->s5[m + i];
+			}
+			fresh = 0;
+		} else {
+			index = (index - scanner->dna->s5[m -1] * top) * model->symbols
+				+ scanner->dna->s5[m + model->length -1];
+		}
+		track[p] = model->data[index];
+	}
+}
+
 static score_t zoeScoreSAM (const zoeScanner scanner, coor_t pos) {
-	coor_t  i;
-	score_t score, s;
-	coor_t  mfocus;
+	coor_t          i;
+	score_t         score, s;
+	coor_t          mfocus;
+	int             stride;
+	const score_t * table;
 	
 	/* user defines and boundaries */
 	if (pos >= 0) {
@@ -183,7 +291,17 @@ static score_t zoeScoreSAM (const zoeScanner scanner, coor_t pos) {
 	
 	/* scoring */
 	score = 0;
-	if (pos >= 0) {
+	if (pos >= 0 && scanner->table && scanner->code) {
+		if ((pos < scanner->first) || (pos > scanner->last)) return MIN_SCORE;
+		stride = zoePOWER[scanner->model->symbols][scanner->model->submodel[0]->length];
+		mfocus = pos - scanner->model->focus - scanner->model->submodel[0]->focus;
+		table  = scanner->table;
+		for (i = 0; i < scanner->model->length; i++, table += stride) {
+			s = table[zoeKMER(scanner->code, mfocus + i)];
+			if (s == MIN_SCORE) return MIN_SCORE;
+			score += s;
+		}
+	} else if (pos >= 0) {
 		mfocus = pos - scanner->model->focus;
 		for (i = 0; i < scanner->model->length; i++) {
 			s = scanner->subscanner[i]->score(scanner->subscanner[i], i + mfocus);
@@ -228,10 +346,100 @@ static score_t zoeScoreTRM (const zoeScanner scanner, coor_t pos) {
 	return MIN_SCORE;
 }
 
+static score_t track_score (const zoeScanner scanner, int anti, int frame, coor_t i) {
+	int n;
+	
+	/* as zoeScoreFeature and zoeScoreCDS call them, frame 0 unless CDS */
+	if (scanner->model->type != CDS) return scanner->score(scanner, anti ? -i : i);
+	if (anti) n = (frame + 3 - i % 3) % 3;
+	else      n = (i + frame) % 3;
+	return scanner->subscanner[n]->score(scanner->subscanner[n], anti ? -i : i);
+}
+
+static struct zoeScanSum * new_scan_sum (const zoeScanner scanner, int anti, int frame) {
+	coor_t              i, length = scanner->dna->length;
+	int                 limit = 0;
+	score_t             s;
+	struct zoeScanSum * t = zoeMalloc(sizeof(struct zoeScanSum));
+	
+	t->sum  = zoeMalloc((length +1) * sizeof(double));
+	t->run  = NULL;
+	t->runs = 0;
+	t->sum[0] = 0;
+	for (i = 0; i < length; i++) {
+		s = track_score(scanner, anti, frame, i);
+		if (s != MIN_SCORE) {
+			t->sum[i+1] = t->sum[i] + s;
+			continue;
+		}
+		t->sum[i+1] = t->sum[i];
+		if (t->runs && t->run[2 * t->runs -1] == i -1) {
+			t->run[2 * t->runs -1] = i;
+			continue;
+		}
+		if (t->runs == limit) {
+			limit = (limit) ? limit * 2 : 16;
+			t->run = zoeRealloc(t->run, 2 * limit * sizeof(coor_t));
+		}
+		t->run[2 * t->runs]    = i;
+		t->run[2 * t->runs +1] = i;
+		t->runs++;
+	}
+	return t;
+}
+
+static void delete_scan_sums (zoeScanner scanner) {
+	int i, j;
+	
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < 3; j++) {
+			if (scanner->track[i][j] == NULL) continue;
+			if (scanner->track[i][j]->run) zoeFree(scanner->track[i][j]->run);
+			zoeFree(scanner->track[i][j]->sum);
+			zoeFree(scanner->track[i][j]);
+			scanner->track[i][j] = NULL;
+		}
+	}
+}
+
+static void drop_scan_sums (zoeScanner scanner) {
+	
+	/* a parent's sums are made over its subscanners' scores */
+	for (; scanner; scanner = scanner->parent) delete_scan_sums(scanner);
+}
+
+static int scan_sum (zoeScanner scanner, int anti, int frame, coor_t start, coor_t end,
+	score_t * score)
+{
+	int                 lo, hi, mid;
+	struct zoeScanSum * t;
+	
+	/* start..end with two lookups; 0 if not summed, MIN_SCORE if it has one */
+	if (!scanner->cumulative || start < 0 || end >= scanner->dna->length) return 0;
+	if (scanner->track[anti][frame] == NULL) {
+		scanner->track[anti][frame] = new_scan_sum(scanner, anti, frame);
+	}
+	t = scanner->track[anti][frame];
+	
+	lo = 0;
+	hi = t->runs;
+	while (lo < hi) { /* first run ending at start or later */
+		mid = (lo + hi) / 2;
+		if (t->run[2 * mid +1] < start) lo = mid +1;
+		else                            hi = mid;
+	}
+	if (lo < t->runs && t->run[2 * lo] <= end) *score = MIN_SCORE;
+	else *score = (score_t)(t->sum[end +1] - t->sum[start]);
+	return 1;
+}
+
 static score_t zoeScoreFeature (const zoeScanner scanner, zoeFeature f) {
 	coor_t  i;
 	score_t s, score = 0;
 	
+	if (f->start <= f->end
+		&& scan_sum(scanner, f->strand != '+', 0, f->start, f->end, &score)) return score;
+	
 	if (f->strand == '+') {
 		for (i = f->start; i <= f->end; i++) {
 			s = scanner->score(scanner, i);
@@ -278,6 +486,9 @@ static score_t zoeScoreCDS (const zoeScanner scanner, zoeFeature f) {
 		}
 	
 		score = 0;
+		if (start > end) return 0;
+		if (scan_sum(scanner, 0, ((4 - f->inc5 - start) % 3 + 3) % 3, start, end, &score))
+			return (score == MIN_SCORE) ? 0 : score; /* as the loop */
 		for (i = start; i <= end; i++) {
 			n = (i - start + 4 - f->inc5) % 3;
 			s = scanner->subscanner[n]->score(scanner->subscanner[n], i);
@@ -308,6 +519,9 @@ static score_t zoeScoreCDS (const zoeScanner scanner, zoeFeature f) {
 		}
 	
 		score = 0;
+		if (start > end) return 0;
+		if (scan_sum(scanner, 1, (start + f->inc5) % 3, start, end, &score))
+			return (score == MIN_SCORE) ? 0 : score;
 		for (i = start; i <= end; i++) {
 			n = (i -start +3 - f->inc5) % 3;
 			switch (n) {
@@ -336,6 +550,41 @@ static score_t zoeScoreCDS (const zoeScanner scanner, zoeFeature f) {
 	return score;
 }
 
+static void flatten_sam (zoeScanner scanner) {
+	int      i, stride;
+	zoeModel sub, lut = scanner->model->submodel[0];
+	
+	/*
+		A SAM whose columns are LUTs of one shape is scored from a single
+		table, indexed by the shared k-mer codes. first and last fold the
+		columns' boundaries into the SAM's own, so a position is checked
+		once. Columns are private to the SAM and never take user scores.
+		Only the plus strand is flattened.
+	*/
+	if (scanner->model->submodels != scanner->model->length) return;
+	for (i = 0; i < scanner->model->submodels; i++) {
+		sub = scanner->model->submodel[i];
+		if (sub->type != LUT || sub->symbols != lut->symbols ||
+			sub->length != lut->length || sub->focus != lut->focus) return;
+	}
+	
+	stride = zoePOWER[lut->symbols][lut->length];
+	scanner->table = zoeMalloc(scanner->model->length * stride * sizeof(score_t));
+	for (i = 0; i < scanner->model->length; i++) {
+		memcpy(scanner->table + i * stride, scanner->model->submodel[i]->data,
+			stride * sizeof(score_t));
+	}
+	scanner->code  = scanner->subscanner[0]->code;
+	scanner->first = scanner->min_pos;
+	scanner->last  = scanner->max_pos;
+	for (i = 0; i < scanner->model->length; i++) {
+		if (scanner->subscanner[i]->min_pos + scanner->model->focus - i > scanner->first)
+			scanner->first = scanner->subscanner[i]->min_pos + scanner->model->focus - i;
+		if (scanner->subscanner[i]->max_pos + scanner->model->focus - i < scanner->last)
+			scanner->last  = scanner->subscanner[i]->max_pos + scanner->model->focus - i;
+	}
+}
+
 static score_t zoeIllegalScore (const zoeScanner s, coor_t p) {
 	zoeExit("illegal score (%s)", s->model->name);
 	return 0;
@@ -366,6 +615,18 @@ void zoeDeleteScanner(zoeScanner scanner) {
 		zoeFree(scanner->sig);
 		scanner->sig = NULL;
 	}
+	if (scanner->node) {
+		zoeFree(scanner->node);
+		scanner->node = NULL;
+	}
+	if (scanner->table) {
+		zoeFree(scanner->table);
+		scanner->table = NULL;
+	}
+	if (scanner->column) {
+		zoeFree(scanner->column);
+		scanner->column = NULL;
+	}
 	if (scanner->uscore) {
 		zoeFree(scanner->uscore);
 		scanner->uscore = NULL;
@@ -374,6 +635,7 @@ void zoeDeleteScanner(zoeScanner scanner) {
 		zoeFree(scanner->ascore);
 		scanner->ascore = NULL;
 	}
+	delete_scan_sums(scanner);
 	
 	scanner->model = NULL;
 	scanner->dna   = NULL;
@@ -396,11 +658,24 @@ zoeScanner zoeNewScanner(zoeDNA dna, zoeDNA anti, zoeModel model) {
 	scanner->anti        = anti;
 	scanner->model       = model;
 	scanner->subscanner  = NULL;
+	scanner->parent      = NULL;
 	scanner->sig         = NULL;
+	scanner->node        = NULL;
+	scanner->column      = NULL;
+	scanner->columns     = 0;
 	scanner->uscore      = NULL;
 	scanner->ascore      = NULL;
 	scanner->score       = NULL;
 	scanner->scoref      = NULL;
+	scanner->code        = NULL;
+	scanner->acode       = NULL;
+	scanner->table       = NULL;
+	scanner->first       = 0;
+	scanner->last        = -1;
+	scanner->cumulative  = 0;
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < 3; j++) scanner->track[i][j] = NULL;
+	}
 	
 	/* bind scoring and counting functions to type of model */
 	switch (model->type) {
@@ -419,15 +694,26 @@ zoeScanner zoeNewScanner(zoeDNA dna, zoeDNA anti, zoeModel model) {
 		default:  scanner->scoref = zoeScoreFeature;
 	}
 	
+	/* LUTs of the same size share the k-mer codes of each strand */
+	if (model->type == LUT) {
+		scanner->code = zoeKmerCodes(dna, model->symbols, model->length);
+		if (anti) scanner->acode = zoeKmerCodes(anti, model->symbols, model->length);
+	}
+	
 	/* create subscanners for constructed types */
 	if (model->type == WMM || model->type == LUT || model->type == TRM) {
 		scanner->subscanner = NULL;
 	} else {
 		scanner->subscanner = zoeMalloc(model->submodels * sizeof(struct zoeScanner));
-		for (i = 0; i< model->submodels; i++)
+		for (i = 0; i< model->submodels; i++) {
 			scanner->subscanner[i] = zoeNewScanner(dna, anti, model->submodel[i]);
+			scanner->subscanner[i]->parent = scanner;
+		}
 	}
 	
+	/* flatten SAM columns into one table */
+	if (model->type == SAM) flatten_sam(scanner);
+	
 	/* ensure CDS model is correctly used */
 	if (model->type == CDS) {
 		if (model->submodels != 3) zoeExit("CDS must have 3 submodels");
@@ -448,6 +734,7 @@ zoeScanner zoeNewScanner(zoeDNA dna, zoeDNA anti, zoeModel model) {
 					seq2sig(model->submodel[i]->name[j]);
 			}
 		}
+		compile_sdt(scanner);
 			
 	} else {
 		scanner->sig = NULL;
@@ -456,6 +743,26 @@ zoeScanner zoeNewScanner(zoeDNA dna, zoeDNA anti, zoeModel model) {
 	return scanner;
 }
 
+void zoeClearScannerScores (zoeScanner scanner) {
+	int i;
+	
+	/* drop all user-defined scores, also those of the subscanners */
+	if (scanner->model->submodels) {
+		for (i = 0; i < scanner->model->submodels; i++) {
+			if (scanner->subscanner[i]) zoeClearScannerScores(scanner->subscanner[i]);
+		}
+	}
+	if (scanner->uscore) {
+		zoeFree(scanner->uscore);
+		scanner->uscore = NULL;
+	}
+	if (scanner->ascore) {
+		zoeFree(scanner->ascore);
+		scanner->ascore = NULL;
+	}
+	drop_scan_sums(scanner);
+}
+
 void zoeSetScannerScore(zoeScanner scanner, coor_t pos, score_t score) {
 	coor_t i;
 		
@@ -484,6 +791,91 @@ void zoeSetScannerScore(zoeScanner scanner, coor_t pos, score_t score) {
 		}
 		scanner->ascore[-pos] = score;
 	}
+	drop_scan_sums(scanner); /* made again when next used */
+}
+
+void zoeDropScannerCodes (zoeScanner scanner) {
+	int i;
+	
+	/* before zoeDropKmerCodes; LUTs then index the sequence themselves */
+	scanner->code  = NULL;
+	scanner->acode = NULL;
+	if (scanner->subscanner == NULL) return;
+	for (i = 0; i < scanner->model->submodels; i++) {
+		zoeDropScannerCodes(scanner->subscanner[i]);
+	}
+}
+
+void zoeScoreTrack (zoeScanner scanner, coor_t from, coor_t to, score_t * track) {
+	int         k, s, subs, * count;
+	coor_t      p, end, * list;
+	score_t     out[TRACK_BATCH];
+	zoeScanner  sub;
+	
+	/*
+		track[p] is scanner->score(scanner, p) for from <= p < to. LUTs
+		roll their index along the track. WMMs, alone or as SDT leaves,
+		are scored through wmm_batch: positions that pass the user scores
+		and boundaries are gathered per model and scored a batch at a time.
+	*/
+	if (scanner->score == zoeScoreLUT) {
+		lut_track(scanner, from, to, track);
+		return;
+	}
+	if (scanner->score != zoeScoreWMM && scanner->score != zoeScoreSDT) {
+		for (p = from; p < to; p++) track[p] = scanner->score(scanner, p);
+		return;
+	}
+	
+	subs  = (scanner->score == zoeScoreSDT) ? scanner->model->submodels : 1;
+	list  = zoeMalloc(subs * TRACK_BATCH * sizeof(coor_t));
+	count = zoeMalloc(subs * sizeof(int));
+	
+	for (; from < to; from = end) {
+		end = (to - from > TRACK_BATCH) ? from + TRACK_BATCH : to;
+		for (s = 0; s < subs; s++) count[s] = 0;
+		
+		for (p = from; p < end; p++) {
+			if (scanner->uscore && scanner->uscore[p] != MIN_SCORE) {
+				track[p] = scanner->uscore[p];
+				continue;
+			}
+			if (p < scanner->min_pos || p > scanner->max_pos) {
+				track[p] = MIN_SCORE;
+				continue;
+			}
+			if (scanner->score == zoeScoreWMM) {
+				list[count[0]++] = p;
+				continue;
+			}
+			s   = zoeSDTlookup(scanner, p - scanner->model->focus);
+			sub = scanner->subscanner[s];
+			if (sub->score != zoeScoreWMM) track[p] = sub->score(sub, p);
+			else if (sub->uscore && sub->uscore[p] != MIN_SCORE) track[p] = sub->uscore[p];
+			else if (p < sub->min_pos || p > sub->max_pos) track[p] = MIN_SCORE;
+			else list[s * TRACK_BATCH + count[s]++] = p;
+		}
+		
+		for (s = 0; s < subs; s++) {
+			if (count[s] == 0) continue;
+			sub = (scanner->score == zoeScoreWMM) ? scanner : scanner->subscanner[s];
+			wmm_batch(sub, list + s * TRACK_BATCH, count[s], out);
+			for (k = 0; k < count[s]; k++) track[list[s * TRACK_BATCH + k]] = out[k];
+		}
+	}
+	
+	zoeFree(list);
+	zoeFree(count);
+}
+
+void zoeSumScanner (zoeScanner scanner) {
+	
+	/*
+		Features are scored from cumulative sums of each strand (and frame,
+		for CDS), made the first time one is needed. MIN_SCORE positions
+		are kept as runs, so a feature holding one still scores as before.
+	*/
+	scanner->cumulative = 1;
 }
 
 #endif
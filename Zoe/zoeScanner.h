@@ -40,6 +40,12 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 #include "zoeModel.h"
 #include "zoeTools.h"
 
+struct zoeScanSum {
+	double * sum;  /* score of every position before, MIN_SCORE counted as 0 */
+	coor_t * run;  /* first and last position of each MIN_SCORE run */
+	int      runs;
+};
+
 struct zoeScanner  {
 	coor_t               min_pos;    /* minimum scoring position */
 	coor_t               max_pos;    /* maximum scoring position */
@@ -47,9 +53,20 @@ struct zoeScanner  {
 	zoeDNA               anti;       /* reverse-complement */
 	zoeModel             model;      /* scanners require a model */
 	struct zoeScanner ** subscanner; /* for higher order models */
+	struct zoeScanner  * parent;     /* scanner this is a subscanner of, or NULL */
 	char               * sig;        /* binary signature (SDT) */
+	int                * node;       /* submodel by packed s16 of the columns (SDT) */
+	int                * column;     /* offsets where some signature is not N */
+	int                  columns;
 	score_t            * uscore;     /* user-defined score */
 	score_t            * ascore;     /* user-defined anti-parallel score */
+	const struct zoeKmers * code;    /* LUT index at each position, see zoeKmerCodes */
+	const struct zoeKmers * acode;   /* the same, anti-parallel */
+	score_t            * table;      /* LUT columns of a SAM end to end, see flatten_sam */
+	coor_t               first;      /* positions every column of the SAM can score */
+	coor_t               last;
+	int                  cumulative; /* score ranges with sums, see zoeSumScanner */
+	struct zoeScanSum  * track[2][3];/* [anti][frame] sums, made when first used */
 	score_t           (* score) (struct zoeScanner *, coor_t);
 	score_t           (* scoref)(struct zoeScanner *, zoeFeature);
 };
@@ -58,5 +75,9 @@ typedef struct zoeScanner * zoeScanner;
 void       zoeDeleteScanner (zoeScanner);
 zoeScanner zoeNewScanner (zoeDNA, zoeDNA, zoeModel);
 void       zoeSetScannerScore (zoeScanner, coor_t, score_t);
+void       zoeClearScannerScores (zoeScanner);
+void       zoeSumScanner (zoeScanner);
+void       zoeScoreTrack (zoeScanner, coor_t, coor_t, score_t *);
+void       zoeDropScannerCodes (zoeScanner);
 
 #endif
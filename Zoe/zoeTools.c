@@ -35,6 +35,9 @@ const coor_t   UNDEFINED_COOR = -1;
 const frame_t  UNDEFINED_FRAME = -1;
 const score_t  MIN_SCORE = -FLT_MAX;
 const score_t  MAX_SCORE = FLT_MAX;
+const fixed_t  MIN_FIXED = INT_MIN;
+const fixed_t  MAX_FIXED = INT_MAX;
+const fixed_t  FIXED_SCALE = 256; /* units per bit */
 const strand_t UNDEFINED_STRAND = 0;
 
 
@@ -54,12 +54,16 @@ char * zoeOption (const char *);
 typedef int   coor_t;    /* coordinates */
 typedef char  frame_t;   /* reading frame, inc5, inc3 */
 typedef float score_t;   /* scores */
+typedef int   fixed_t;   /* fixed-point scores, see zoeScore2Fixed */
 typedef char  strand_t;  /* strand */
 
 extern const coor_t   UNDEFINED_COOR;
 extern const frame_t  UNDEFINED_FRAME;
 extern const score_t  MIN_SCORE;
 extern const score_t  MAX_SCORE;
+extern const fixed_t  MIN_FIXED;
+extern const fixed_t  MAX_FIXED;
+extern const fixed_t  FIXED_SCALE;
 extern const strand_t UNDEFINED_STRAND;
 
 void     zoeCoor2Text   (coor_t, char *);
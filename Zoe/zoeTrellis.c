@@ -31,6 +31,10 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 
 #include "zoeTrellis.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 /****************************************************************************\
  PRIVATE FUNCTIONS
 \****************************************************************************/
@@ -85,70 +89,163 @@ static int PADDING = 48;
 
 static int PROGRESS_METER = 1;
 
+static int LOW_MEMORY = 0;
+
+static int KBEST = 1; /* scores kept per state and position */
+
+static int FIXED_POINT = 0; /* integer score rows, see fixed_add */
+
+#define TRACK_BLOCK 1024 /* rows of content scores computed at a time */
+
+/* score rows are position-major: one row per position, one column per state
+   and rank, ranks 0..kbest-1 are consecutive blocks of slots */
+#define SCORE(t, state, i) ((t)->score[((i) & (t)->mask) * (t)->width + (t)->slot[(state)]])
+#define FIXED_SCORE(t, state, i) ((t)->iscore[((i) & (t)->mask) * (t)->width + (t)->slot[(state)]])
+#define RANK_SCORE(t, state, r, i) \
+	((t)->score[((i) & (t)->mask) * (t)->width + (r) * (t)->slots + (t)->slot[(state)]])
+
+static int     BEAM       = 0;
+static score_t BEAM_WIDTH = 0; /* bits below the best, negative for none */
+static score_t BEAM_FLOOR = 0; /* absolute floor, MIN_SCORE for none */
+
 struct my_max {
 	zoeLabel state;
 	coor_t   coor;
 	score_t  score;
 };
 
-static void delete_external_features (zoeTrellis trellis) {
-	int state;
-	for (state = 0; state < zoeLABELS; state++) {
-		if (trellis->features[state] == NULL) continue;
-		zoeDeleteFeatureVec(trellis->features[state]);
-		trellis->features[state] = NULL;
+static void delete_trace (zoeTraceVec vec) {
+	if (vec == NULL) return;
+	if (vec->elem) zoeFree(vec->elem);
+	zoeFree(vec);
+}
+
+static zoeTraceVec new_trace (void) {
+	zoeTraceVec vec = zoeMalloc(sizeof(struct zoeTraceVec));
+	vec->elem  = NULL;
+	vec->size  = 0;
+	vec->limit = 0;
+	return vec;
+}
+
+static void push_trace (zoeTraceVec vec, coor_t pos, zoeLabel pre_state,
+	const zoeFeature f, score_t score, int rank)
+{
+	struct zoeTraceEvent * e;
+	
+	if (vec->limit == vec->size) {
+		if (vec->limit == 0) vec->limit  = 64;
+		else                 vec->limit *= 2;
+		vec->elem = zoeRealloc(vec->elem, vec->limit * sizeof(struct zoeTraceEvent));
+	}
+	
+	e = &vec->elem[vec->size];
+	e->pos       = pos;
+	e->pre_state = pre_state;
+	e->rank      = rank;
+	vec->size++;
+	
+	/* no feature: the state continues from another rank at pos -1 */
+	if (f == NULL) {
+		e->label  = None;
+		e->start  = pos;
+		e->end    = pos;
+		e->score  = 0;
+		e->inc5   = 0;
+		e->inc3   = 0;
+		e->frame  = 0;
+		e->strand = '+';
+		return;
 	}
+	
+	e->label     = f->label;
+	e->start     = f->start;
+	e->end       = f->end;
+	e->score     = score;
+	e->inc5      = f->inc5;
+	e->inc3      = f->inc3;
+	e->frame     = f->frame;
+	e->strand    = f->strand;
 }
 
-static void transfer_exons (zoeTrellis trellis, zoeFeatureVec sfv) {
-	int i;
-	coor_t length;
-	zoeFeature exon;
+static int last_trace (const zoeTraceVec vec, coor_t pos) {
+	int lo, hi, mid, step;
+	
+	/* index of the last event at or before pos, -1 if there isn't one */
+	if (vec->size == 0 || vec->elem[0].pos > pos) return -1;
+	hi = vec->size -1;
+	if (vec->elem[hi].pos <= pos) return hi;
+	
+	/* lookups are usually near the end, so gallop back before bisecting */
+	step = 1;
+	lo = hi - step;
+	while (lo > 0 && vec->elem[lo].pos > pos) {
+		hi = lo;
+		step *= 2;
+		lo = hi - step;
+	}
+	if (lo < 0) lo = 0;
 	
-	for (i = 0; i < sfv->size; i++) {
-		exon = sfv->elem[i];
-		
-		
-		
-		/* min length filter */
-		length = exon->end - exon->start + 1;
-		if (length < trellis->min_len[exon->label]) continue;
-		
-		/* padding filter */
-		if (exon->start < PADDING) continue;
-		if (exon->end >= trellis->dna->length) continue;
-		
-		/* create if necessary */
-		if (trellis->features[exon->label] == NULL) {
-			trellis->features[exon->label] = zoeNewFeatureVec();
-		}
-		
-		zoePushFeatureVec(trellis->features[exon->label], exon);
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (vec->elem[mid].pos <= pos) lo = mid;
+		else                           hi = mid;
 	}
+	return lo;
 }
 
-static void compute_external_features (zoeTrellis trellis, coor_t pos) {
-	zoeFeatureFactory factory;
-	zoeFeatureVec     sfv;
-	int               state;
+static zoeTraceVec rank_trace (const zoeTrellis trellis, zoeLabel state, int rank) {
+	return (rank == 0) ? trellis->trace[state] : trellis->ranked[state][rank];
+}
+
+static zoeFeature trace_feature (const struct zoeTraceEvent * e) {
+	return zoeNewFeature(e->label, e->start, e->end, e->strand, e->score,
+		e->inc5, e->inc3, e->frame, NULL);
+}
+
+
+static int legal_exon (zoeTrellis trellis, zoeFeature exon) {
+	coor_t length;
 	
-	for (state = 0; state < zoeLABELS; state++) {
-		if (trellis->factory[state] == NULL) continue;
-		factory = trellis->factory[state];
-		if (factory == NULL) continue;
+	/* min length filter */
+	length = exon->end - exon->start + 1;
+	if (length < trellis->min_len[exon->label]) return 0;
+	
+	/* padding filter */
+	if (exon->start < PADDING) return 0;
+	if (exon->end >= trellis->dna->length) return 0;
+	
+	return 1;
+}
 
-		sfv = factory->create(factory, pos);
-		if (sfv == NULL) continue;
+static void transfer_exons (zoeTrellis trellis, zoeFeatureBuf sfv) {
+	int        i;
+	score_t    best, cutoff = MIN_SCORE;
+	zoeFeature exon;
+	
+	/* beam: all exons here end at the same position, keep those near the best */
+	if (BEAM) {
+		best = MIN_SCORE;
+		for (i = 0; i < sfv->size; i++) {
+			exon = &sfv->elem[i];
+			if (!legal_exon(trellis, exon)) continue;
+			if (exon->score > best) best = exon->score;
+		}
+		cutoff = BEAM_FLOOR;
+		if (BEAM_WIDTH >= 0 && best - BEAM_WIDTH > cutoff) cutoff = best - BEAM_WIDTH;
+	}
+	
+	for (i = 0; i < sfv->size; i++) {
+		exon = &sfv->elem[i];
 		
-		switch (state) {
-			case Exon:
-				transfer_exons(trellis, sfv);
-				zoeDeleteFeatureVec(sfv);
-				break;
-			default:
-				if (sfv->last->start < PADDING) sfv->last->start = PADDING;
-				trellis->features[state] = sfv;			
+		if (!legal_exon(trellis, exon)) continue;
+		
+		if (exon->score < cutoff) {
+			trellis->pruned++;
+			continue;
 		}
+		
+		zoePushFeatureBuf(trellis->features[exon->label], exon);
 	}
 }
 
@@ -243,18 +340,187 @@ static int creates_stop_codon (zoeDNA dna, zoeLabel pre_state, zoeFeature exon)
 	}
 }
 
-static score_t pre_state_duration_score (zoeTrellis trellis, zoeLabel state, int int_end) {
-	int i, stop, length;
+static int phase_class (zoeLabel state) {
+	switch (state) {
+		case Int0:   return 0;
+		case Int1:   return 1;
+		case Int1T:  return 2;
+		case Int2:   return 3;
+		case Int2TA: return 4;
+		case Int2TG: return 5;
+		default:     return 6; /* no phase */
+	}
+}
+
+static int phase_classes (zoeTrellis trellis, zoeLabel ext_state, zoeFeature f) {
+	static const zoeLabel state[PHASE_CLASSES] =
+		{Int0, Int1, Int1T, Int2, Int2TA, Int2TG, Inter};
+	int c, legal = 0;
+	
+	/*
+		The three jump filters, once per candidate: bit c is set if a state
+		of class c may precede it, bit c + PHASE_CLASSES if one may follow.
+		Shuttles are not filtered.
+	*/
+	if (ext_state == Repeat || ext_state == ORF || ext_state == CNS) return ~0;
+	for (c = 0; c < PHASE_CLASSES; c++) {
+		if (legal_first_jump(state[c], f) && !creates_stop_codon(trellis->dna, state[c], f))
+			legal |= 1 << c;
+		if (legal_second_jump(trellis->dna, f, state[c]))
+			legal |= 1 << (c + PHASE_CLASSES);
+	}
+	return legal;
+}
+
+static int jump_classes (const struct zoeJump * jump) {
+	return (1 << phase_class(jump->pre_state))
+		| (1 << (phase_class(jump->int_state) + PHASE_CLASSES));
+}
+
+static int compute_external_features (zoeTrellis trellis, coor_t pos) {
+	zoeFeatureFactory factory;
+	zoeFeatureBuf     sfv;
+	int               state, i, c, found = 0;
+	
+	/* the buffers are reused at every position */
+	for (state = 0; state < zoeLABELS; state++) trellis->features[state]->size = 0;
+	
+	for (state = 0; state < zoeLABELS; state++) {
+		if (trellis->factory[state] == NULL) continue;
+		factory = trellis->factory[state];
+		if (factory == NULL) continue;
+		
+		switch (state) {
+			case Exon:
+				trellis->exons->size = 0;
+				if (factory->create(factory, pos, trellis->exons) == 0) break;
+				transfer_exons(trellis, trellis->exons);
+				break;
+			default:
+				sfv = trellis->features[state];
+				if (factory->create(factory, pos, sfv) == 0) break;
+				if (sfv->elem[sfv->size -1].start < PADDING) {
+					sfv->elem[sfv->size -1].start = PADDING;
+				}
+		}
+	}
+	
+	/* no candidate-only scores are known yet; classes are set once */
+	for (state = 0; state < zoeLABELS; state++) {
+		for (c = 0; c < PHASE_CLASSES; c++) trellis->pairs[state][c] = 0;
+		sfv = trellis->features[state];
+		if (sfv->size == 0) continue;
+		found += sfv->size;
+		if (sfv->size > trellis->fixed_limit[state]) {
+			trellis->fixed_limit[state] = sfv->size * 2;
+			trellis->fixed[state] = zoeRealloc(trellis->fixed[state],
+				trellis->fixed_limit[state] * sizeof(score_t));
+			trellis->legal[state] = zoeRealloc(trellis->legal[state],
+				trellis->fixed_limit[state] * sizeof(int));
+		}
+		for (i = 0; i < sfv->size; i++) {
+			if (trellis->mask != -1
+				&& sfv->elem[i].end - sfv->elem[i].start +1 > trellis->mask) {
+				zoeExit("feature at %d is longer than the -lowmem lookback", pos);
+			}
+			trellis->fixed[state][i] = MIN_SCORE;
+			trellis->legal[state][i] = phase_classes(trellis, state, &sfv->elem[i]);
+			for (c = 0; c < PHASE_CLASSES; c++) {
+				if (trellis->legal[state][i] & (1 << (c + PHASE_CLASSES)))
+					trellis->pairs[state][c] |= trellis->legal[state][i];
+			}
+		}
+	}
+	
+	return found;
+}
+
+static coor_t walk_entry (const zoeTrellis trellis, zoeLabel state, int rank, coor_t p) {
+	int                    idx;
+	zoeTraceVec            vec;
+	struct zoeTraceEvent * e;
+	
+	/* from the events, following rank moves as trace_trellis does */
+	while (p > PADDING) {
+		vec = rank_trace(trellis, state, rank);
+		idx = last_trace(vec, p);
+		if (idx == -1) break;
+		e = &vec->elem[idx];
+		if (e->label != None) return (e->pos <= PADDING) ? PADDING : e->pos;
+		rank = e->rank;
+		p    = e->pos -1;
+	}
+	return PADDING;
+}
+
+static void fill_entries (zoeTrellis trellis, zoeLabel state, coor_t to) {
+	int                    r, k = trellis->kbest;
+	int                  * idx = trellis->entry_at[state];
+	coor_t                 p, * cur, * prev;
+	zoeTraceVec            vec;
+	struct zoeTraceEvent * e;
+	
+	/* each rank enters at its own event, takes over a moved rank's, or keeps its own */
+	for (p = trellis->entry_to[state] +1; p <= to; p++) {
+		cur  = trellis->entry[state] + (p & trellis->entry_mask) * k;
+		prev = trellis->entry[state] + ((p -1) & trellis->entry_mask) * k;
+		for (r = 0; r < k; r++) {
+			vec = rank_trace(trellis, state, r);
+			while (idx[r] < vec->size && vec->elem[idx[r]].pos < p) idx[r]++;
+			if (idx[r] == vec->size || vec->elem[idx[r]].pos != p) {
+				cur[r] = prev[r];
+				continue;
+			}
+			e = &vec->elem[idx[r]++];
+			if (e->label == None) cur[r] = prev[e->rank];
+			else                  cur[r] = (p <= PADDING) ? PADDING : p;
+		}
+	}
+	trellis->entry_to[state] = to;
+}
+
+static void reset_entries (zoeTrellis trellis, zoeLabel state, coor_t to) {
+	int     r, k = trellis->kbest;
+	coor_t * cur = trellis->entry[state] + (to & trellis->entry_mask) * k;
+	
+	/* entry[] is read again from the events, starting after to */
+	for (r = 0; r < k; r++) {
+		cur[r] = walk_entry(trellis, state, r, to);
+		trellis->entry_at[state][r] = last_trace(rank_trace(trellis, state, r), to) +1;
+	}
+	trellis->entry_to[state] = to;
+}
+
+static coor_t trace_entry (zoeTrellis trellis, zoeLabel state, int rank, coor_t int_end) {
+	
+	/*
+		The position where this rank of the state was last entered,
+		PADDING if never. entry[] is a ring of all ranks filled forward
+		from the events as lookups reach new positions, so a lookup is
+		one read. Candidates never look back further than the ring;
+		anything older is walked in the events.
+	*/
+	if (int_end > trellis->entry_to[state]) {
+		fill_entries(trellis, state, int_end);
+	} else if (trellis->entry_mask != -1
+		&& trellis->entry_to[state] - int_end > trellis->entry_mask) {
+		return walk_entry(trellis, state, rank, int_end);
+	}
+	return trellis->entry[state][(int_end & trellis->entry_mask) * trellis->kbest + rank];
+}
+
+static score_t pre_state_duration_score (zoeTrellis trellis, zoeLabel state, int rank, int int_end) {
+	int entry, length;
 	
 	/* geometric */
 	if (trellis->hmm->smap[state]->geometric) /* length 1 geometric cost */
 		return zoeScoreDuration(trellis->hmm->dmap[state], 1);
 	
 	
-	/* explicit */
-	stop = PADDING;
-	for (i = int_end; i > stop; i--) if (trellis->trace[state][i] != -1) break;
-	length = int_end -i + 1 + trellis->hmm->cmap[state];
+	/* explicit - where this rank of the state was entered */
+	if (int_end <= PADDING) entry = int_end;
+	else                    entry = trace_entry(trellis, state, rank, int_end);
+	length = int_end - entry + 1 + trellis->hmm->cmap[state];
 		
 	if (length < trellis->min_len[state]) return MIN_SCORE;
 	else return zoeScoreDuration(trellis->hmm->dmap[state], length);
@@ -264,44 +530,192 @@ static score_t pre_state_duration_score (zoeTrellis trellis, zoeLabel state, int
 	return MIN_SCORE;
 }
 
-static score_t internal_score (zoeTrellis trellis, zoeLabel state, coor_t i) {
+static void compute_tracks (zoeTrellis trellis, coor_t from, coor_t to) {
+	coor_t     i;
+	int        s;
+	score_t  * row, column[TRACK_BLOCK];
+	zoeLabel   state;
 	zoeScanner scanner;
-	score_t    content_score, extend_score, prev_score;
 	
-	if (trellis->score[state][i-1] == MIN_SCORE) return MIN_SCORE; /* keep MIN_SCORE */
+	/* content + extension for rows from..to-1, once per distinct scanner */
+	for (s = 0; s < trellis->slots; s++) {
+		state = trellis->state[s];
+		if (state == None || trellis->same[s] != s) continue;
+		scanner = trellis->scanner[state];
+		zoeScoreTrack(scanner, from, to, column - from);
+		for (i = from; i < to; i++) trellis->track[(i - from) * trellis->slots + s] = column[i - from];
+	}
+	for (i = from; i < to; i++) {
+		row = trellis->track + (i - from) * trellis->slots;
+		for (s = 0; s < trellis->slots; s++) {
+			if (trellis->state[s] == None)  row[s] = 0;
+			else if (trellis->same[s] != s) row[s] = row[trellis->same[s]];
+		}
+		for (s = 0; s < trellis->slots; s++) {
+			if (trellis->state[s] == None) continue;
+			row[s] = row[s] + trellis->hmm->xmap[trellis->state[s]];
+		}
+	}
+}
+
+static void internal_step (
+	const score_t * prev,
+	score_t       * cur,
+	const score_t * track,
+	score_t         exp_score,
+	int             slots)
+{
+	int     s;
+#if defined(__SSE__)
+	__m128  min, exp, p, v, m;
+	
+	/* all internal states at once, 4 per step; MIN_SCORE stays MIN_SCORE */
+	min = _mm_set1_ps(MIN_SCORE);
+	exp = _mm_set1_ps(exp_score);
+	for (s = 0; s < slots; s += 4) {
+		p = _mm_loadu_ps(prev + s);
+		v = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(track + s), p), exp);
+		m = _mm_cmpeq_ps(p, min);
+		_mm_storeu_ps(cur + s, _mm_or_ps(_mm_and_ps(m, min), _mm_andnot_ps(m, v)));
+	}
+#else
+	for (s = 0; s < slots; s++) {
+		if (prev[s] == MIN_SCORE) cur[s] = MIN_SCORE;
+		else                      cur[s] = track[s] + prev[s] - exp_score;
+	}
+#endif
+}
+
+static fixed_t fixed_add (fixed_t a, fixed_t b, int * sat) {
+	long long r = (long long)a + b;
+	
+	/*
+		Saturating; finite scores stay above MIN_FIXED/2, so -inf absorbs.
+		A sum of two finite scores outside the range sets *sat, and
+		zoePredictGenes decodes again with floats.
+	*/
+	*sat |= (r > MAX_FIXED)
+		| ((r <= MIN_FIXED / 2) & (a != MIN_FIXED) & (b != MIN_FIXED));
+	r = (r > MAX_FIXED) ? MAX_FIXED : r;
+	return (r <= MIN_FIXED / 2) ? MIN_FIXED : (fixed_t)r;
+}
+
+static void fixed_tracks (zoeTrellis trellis, coor_t rows) {
+	coor_t i;
+	
+	/*
+		Quantized once, so every path adds the same integers. The expected
+		score is subtracted first: rounded on its own it would bias every
+		internal step the same way.
+	*/
+	for (i = 0; i < rows * trellis->slots; i++) {
+		if (trellis->track[i] == MIN_SCORE) trellis->itrack[i] = MIN_FIXED;
+		else trellis->itrack[i] = zoeScore2Fixed(trellis->track[i] - trellis->exp_score);
+	}
+}
+
+static void fixed_step (
+	const fixed_t * prev,
+	fixed_t       * cur,
+	const fixed_t * track,
+	int             slots,
+	int           * sat)
+{
+	int s, any = 0;
 	
-	scanner       = trellis->scanner[state];
-	content_score = scanner->score(scanner, i);
-	extend_score  = trellis->hmm->xmap[state];
-	prev_score    = trellis->score[state][i-1];
+	/* internal_step in integers; branch-free, so it vectorizes */
+	for (s = 0; s < slots; s++) cur[s] = fixed_add(prev[s], track[s], &any);
+	*sat |= any;
+}
 
-	return content_score + extend_score + prev_score - trellis->exp_score;
+static int same_scanner (const zoeScanner a, const zoeScanner b) {
+	if (a->model != b->model) return 0;
+	if ((a->uscore == NULL) != (b->uscore == NULL)) return 0;
+	if ((a->ascore == NULL) != (b->ascore == NULL)) return 0;
+	if (a->uscore && memcmp(a->uscore, b->uscore, a->dna->length * sizeof(score_t)))
+		return 0;
+	if (a->ascore && memcmp(a->ascore, b->ascore, a->anti->length * sizeof(score_t)))
+		return 0;
+	return 1;
+}
+static void map_same_scanners (zoeTrellis trellis) {
+	int j, k;
+	
+	/* states whose content scores are identical share one track */
+	for (j = 0; j < trellis->slots; j++) {
+		trellis->same[j] = j;
+		if (trellis->state[j] == None) continue;
+		for (k = 0; k < j; k++) {
+			if (trellis->same[k] != k || trellis->state[k] == None) continue;
+			if (same_scanner(trellis->scanner[trellis->state[j]],
+					trellis->scanner[trellis->state[k]])) {
+				trellis->same[j] = k;
+				break;
+			}
+		}
+	}
 }
 
+
 struct maxExt {
 	score_t    score;
-	zoeFeature feature;
+	fixed_t    fixed;     /* the score in fixed-point mode */
+	zoeFeature feature;   /* borrowed from trellis->features, not a copy */
+	score_t    fscore;    /* feature score after expected & profile terms */
 	zoeLabel   pre_state;
 };
 
+static score_t fixed_score (const zoeTrellis trellis, const zoeFeature f) {
+	coor_t  length;
+	score_t cscore, dscore;
+	
+	length = f->end - f->start +1;
+	cscore = f->score - trellis->exp_score * length;
+	dscore = zoeScoreDuration(trellis->hmm->dmap[f->label], length);
+	return cscore + dscore;
+}
+
+static score_t static_score (zoeTrellis trellis, zoeLabel ext_state, int j) {
+	
+	/* candidate-only terms, cached for the other (int, pre) state pairs */
+	if (trellis->fixed[ext_state][j] == MIN_SCORE) {
+		trellis->fixed[ext_state][j] = fixed_score(trellis, &trellis->features[ext_state]->elem[j]);
+	}
+	return trellis->fixed[ext_state][j];
+}
+
+static score_t charge_candidate (zoeTrellis trellis, zoeFeature f, coor_t length) {
+	
+	/*
+		The expected score is taken from the candidate itself each time it
+		is scored, so one scored for several (pre, int) state pairs at a
+		position is charged again on every pass. This is how SNAP has
+		always scored; the buffer is remade at the next position.
+	*/
+	f->score -= trellis->exp_score * length;
+	return f->score + zoeScoreDuration(trellis->hmm->dmap[f->label], length);
+}
+
 static struct maxExt external_score (
 	zoeTrellis trellis,
 	coor_t     pos,
-	zoeLabel   int_state)
+	zoeLabel   int_state,
+	score_t    floor_score)
 {
-	int               i, j, length;
-	score_t           cscore, dscore, t1score, t2score, phscore1, phscore2,
-	                  xscore, total_score, pre_score, exp_score, pro_score = 0;
+	int               j, k, length, need, bound;
+	score_t           phscore1, xscore, total_score, pre_score, pro_score, limit, cscore;
+	int               pre_slot;
 	zoeLabel          pre_state, ext_state;
-	zoeIVec           ivec;
 	zoeFeature        f;
 	zoeHMM            hmm = trellis->hmm;
-	zoeDNA            dna = trellis->dna;
-	zoeFeatureVec     sfv;
+	zoeFeatureBuf     sfv;
+	struct zoeJump  * jump;
 	struct maxExt     max;
 	
 	max.score     = MIN_SCORE;
+	max.fixed     = MIN_FIXED;
 	max.feature   = NULL;
+	max.fscore    = MIN_SCORE;
 	max.pre_state = -1;
 		
 /*	    pre_state          ext_state        int_state
@@ -314,103 +728,433 @@ static struct maxExt external_score (
          xscore
 	              ...[......content......]...
 	                 <------duration----->
+	
+	The sum keeps its original order so scores do not change:
+	(content - expected + duration) + t1 + t2 + xscore + pre + phase1
+	+ phase2 + profile. The first group is charge_candidate, which lowers
+	the candidate's own score every time it gets this far, and the
+	profile score is added to it as well; the transition and phase terms
+	are fixed for each (ext_state, pre_state) pair.
+	
+	The same sum with the highest duration score of the pre-state bounds
+	the total exactly, as float addition is monotone. A candidate whose
+	bound does not beat the best so far, or floor_score (the internal
+	score it has to replace), is not summed further. Its duration is
+	still looked up first, as that decides whether it is charged.
 */
 
 	
-	/* external states */	
-	for (ext_state = 0; ext_state < zoeLABELS; ext_state++) {
-		if (hmm->jmap[int_state][ext_state] == NULL) continue;
-						
-		ivec = hmm->jmap[int_state][ext_state];
+	/* external states, one compiled jump at a time */
+	for (k = hmm->jump_at[int_state]; k < hmm->jump_at[int_state +1]; k++) {
+		jump = &hmm->jump[k];
+		sfv  = trellis->features[jump->ext_state];
+		if (sfv->size == 0) continue;
+		
+		/* only jumps some candidate here fits, only the candidates that fit */
+		ext_state = jump->ext_state;
+		pre_state = jump->pre_state;
+		if (!(trellis->pairs[ext_state][phase_class(int_state)]
+			& (1 << phase_class(pre_state)))) continue;
+		need      = jump_classes(jump);
+		pre_slot  = trellis->slot[pre_state];
+		phscore1  = (jump->exonic) ? trellis->phase_in[pre_state][ext_state] : 0;
+		bound     = trellis->max_dur[pre_state] != MAX_SCORE
+			&& !(jump->exonic && trellis->ext);
 		
-		for (i = 0; i < ivec->size; i++) {
-			pre_state = ivec->elem[i];
+		for (j = 0; j < sfv->size; j++) {
+			f = &sfv->elem[j];
 			
-			sfv = trellis->features[ext_state];
-			if (sfv == NULL) continue;
+			length    = f->end - f->start +1;
+			pre_score = trellis->score[((pos -length) & trellis->mask)
+				* trellis->width + pre_slot];
 			
-			for (j = 0; j < sfv->size; j++) {
-				f = sfv->elem[j];
-				
-				length    = f->end - f->start +1;
-				pre_score = trellis->score[pre_state][pos -length];
-				
-				/* filters */
-				if (pre_score == MIN_SCORE) continue;
-				
-				if (f->label == Repeat || f->label == ORF || f->label == CNS) {
-					if (pre_state != int_state) continue; /* shuttle */
+			/* filters */
+			if (pre_score == MIN_SCORE) continue;
+			if ((trellis->legal[ext_state][j] & need) != need) continue;
+			
+			/* pre-state duration score */
+			xscore = pre_state_duration_score(trellis, pre_state, 0, f->start -1);
+
+			if (xscore == MIN_SCORE) continue;
+			
+			/* candidate score, less another expected score */
+			cscore = charge_candidate(trellis, f, length);
+			
+			/* exact bound */
+			if (bound) {
+				limit = (max.score > floor_score) ? max.score : floor_score;
+				if (jump->exonic) {
+					total_score = cscore
+						+ jump->t1score + jump->t2score + trellis->max_dur[pre_state]
+						+ pre_score + phscore1
+						+ trellis->phase_out[ext_state][int_state][(int)f->inc5];
 				} else {
-					if (!legal_first_jump(pre_state, f))        continue;
-					if (!legal_second_jump(dna, f, int_state))  continue;
-					if (creates_stop_codon(dna, pre_state, f))  continue;
+					total_score = cscore
+						+ jump->t1score + jump->t2score + trellis->max_dur[pre_state]
+						+ pre_score;
 				}
-				
-				/* pre-state duration score */
-				xscore = pre_state_duration_score(trellis, pre_state, f->start -1);
+				if (total_score <= limit) {
+					trellis->bounded++;
+					continue;
+				}
+			}
+			
+			/* profile score, kept by the candidate too */
+			pro_score = 0;
+			if (jump->exonic && trellis->ext) {
+				pro_score = trellis->ext(trellis, pos, pre_state, f);
+				f->score += pro_score;
+			}
+			
+			/* total score */
+			if (jump->exonic) {
+				total_score = cscore
+					+ jump->t1score + jump->t2score + xscore + pre_score + phscore1
+					+ trellis->phase_out[ext_state][int_state][(int)f->inc5]
+					+ pro_score;
+			} else {
+				total_score = cscore
+					+ jump->t1score + jump->t2score + xscore + pre_score;
+			}
+						
+			if (total_score > max.score) {
+				max.score     = total_score;
+				max.pre_state = pre_state;
+				max.feature   = f;
+				max.fscore    = f->score;
+			}
+		}
+	}
+	
+	return max;
+}
+
+static score_t edge_score (
+	zoeTrellis trellis,
+	coor_t     pos,
+	zoeLabel   ext_state,
+	zoeFeature f,
+	int        j,
+	zoeLabel   pre_state,
+	zoeLabel   int_state)
+{
+	int     exonic, shuttle, need;
+	score_t xscore, score;
+	zoeHMM  hmm = trellis->hmm;
+	
+	/* external_score less the pre-state score, MIN_SCORE where it filters */
+	exonic  = (ext_state == Einit || ext_state == Eterm
+	        || ext_state == Exon  || ext_state == Esngl);
+	shuttle = (ext_state == Repeat || ext_state == ORF || ext_state == CNS);
+	
+	need = (1 << phase_class(pre_state)) | (1 << (phase_class(int_state) + PHASE_CLASSES));
+	if (shuttle) {
+		if (pre_state != int_state) return MIN_SCORE;
+	} else if (j != -1) {
+		if ((trellis->legal[ext_state][j] & need) != need)  return MIN_SCORE;
+	} else {
+		if (!legal_first_jump(pre_state, f))                return MIN_SCORE;
+		if (!legal_second_jump(trellis->dna, f, int_state)) return MIN_SCORE;
+		if (creates_stop_codon(trellis->dna, pre_state, f)) return MIN_SCORE;
+	}
+	
+	xscore = pre_state_duration_score(trellis, pre_state, 0, f->start -1);
+	if (xscore == MIN_SCORE) return MIN_SCORE;
+	
+	/* candidate j of trellis->features, or -1 for one that is not there */
+	score = (j == -1) ? fixed_score(trellis, f) : static_score(trellis, ext_state, j);
+	score += hmm->tmap[ext_state][int_state] + hmm->tmap[pre_state][ext_state]
+		+ xscore;
+	if (exonic) {
+		score += trellis->phase_in[pre_state][ext_state]
+			+ trellis->phase_out[ext_state][int_state][(int)f->inc5];
+		if (trellis->ext) score += trellis->ext(trellis, pos, pre_state, f);
+	}
+	
+	return score;
+}
+
+static struct maxExt external_fixed (
+	zoeTrellis trellis,
+	coor_t     pos,
+	zoeLabel   int_state)
+{
+	int              j, k, need;
+	coor_t           length;
+	fixed_t          pre_score, total;
+	score_t          edge, xscore, pro_score;
+	zoeLabel         pre_state, ext_state;
+	zoeFeature       f;
+	zoeHMM           hmm = trellis->hmm;
+	zoeFeatureBuf    sfv;
+	struct zoeJump * jump;
+	struct maxExt    max;
+	
+	/* external_score on fixed-point rows; each edge is quantized once */
+	max.score     = MIN_SCORE;
+	max.fixed     = MIN_FIXED;
+	max.feature   = NULL;
+	max.fscore    = MIN_SCORE;
+	max.pre_state = -1;
+	
+	for (k = hmm->jump_at[int_state]; k < hmm->jump_at[int_state +1]; k++) {
+		jump      = &hmm->jump[k];
+		ext_state = jump->ext_state;
+		pre_state = jump->pre_state;
+		sfv       = trellis->features[ext_state];
+		if (!(trellis->pairs[ext_state][phase_class(int_state)]
+			& (1 << phase_class(pre_state)))) continue;
+		
+		need      = jump_classes(jump);
+		
+		for (j = 0; j < sfv->size; j++) {
+			f = &sfv->elem[j];
+			length    = f->end - f->start +1;
+			pre_score = FIXED_SCORE(trellis, pre_state, pos - length);
+			if (pre_score == MIN_FIXED) continue;
+			if ((trellis->legal[ext_state][j] & need) != need) continue;
+			
+			xscore = pre_state_duration_score(trellis, pre_state, 0, f->start -1);
+			if (xscore == MIN_SCORE) continue;
+			
+			/* charged like external_score, so the decodings agree */
+			edge = charge_candidate(trellis, f, length);
+			pro_score = 0;
+			if (jump->exonic && trellis->ext) {
+				pro_score = trellis->ext(trellis, pos, pre_state, f);
+				f->score += pro_score;
+			}
+			edge += jump->t1score + jump->t2score + xscore;
+			if (jump->exonic) {
+				edge += trellis->phase_in[pre_state][ext_state]
+					+ trellis->phase_out[ext_state][int_state][(int)f->inc5];
+			}
+			edge += pro_score;
+			total = fixed_add(pre_score, zoeScore2Fixed(edge), &trellis->saturated);
+			
+			if (total > max.fixed) {
+				max.fixed     = total;
+				max.score     = zoeFixed2Score(total);
+				max.pre_state = pre_state;
+				max.feature   = f;
+				max.fscore    = f->score;
+			}
+		}
+	}
+	
+	return max;
+}
+
+struct rankExt {
+	score_t    score;
+	zoeFeature feature;   /* NULL if the internal score of another rank */
+	score_t    fscore;
+	zoeLabel   pre_state;
+	int        rank;      /* rank of the pre-state, or of the state at pos -1 */
+};
+
+static int insert_rank (struct rankExt * best, int size, int k, const struct rankExt * c) {
+	int r;
+	
+	/* sorted best first; ties keep the earlier entry ahead, as external_score does */
+	if (size == k && c->score <= best[k-1].score) return size;
+	r = (size < k) ? size : k -1;
+	while (r > 0 && best[r-1].score < c->score) {
+		best[r] = best[r-1];
+		r--;
+	}
+	best[r] = *c;
+	return (size < k) ? size +1 : size;
+}
+
+static score_t rank_total (
+	const struct zoeJump * jump,
+	score_t                cscore,
+	score_t                xscore,
+	score_t                pre_score,
+	score_t                phscore1,
+	score_t                phscore2,
+	score_t                pro_score)
+{
+	/* same sum, in the same order, as external_score */
+	if (jump->exonic) {
+		return cscore
+			+ jump->t1score + jump->t2score + xscore + pre_score + phscore1
+			+ phscore2
+			+ pro_score;
+	}
+	return cscore + jump->t1score + jump->t2score + xscore + pre_score;
+}
+
+static int same_origin (const struct rankExt * a, const struct rankExt * b) {
+	return a->feature == b->feature && a->pre_state == b->pre_state && a->rank == b->rank;
+}
 
-				if (xscore == MIN_SCORE) continue;
+static void external_kbest (
+	zoeTrellis       trellis,
+	coor_t           pos,
+	score_t        * row,
+	struct rankExt * best)
+{
+	int               j, m, q, r, s, n, length, need, charged;
+	score_t           phscore1, phscore2, xscore, pre_score, pro_score, cscore, kept;
+	int               k = trellis->kbest;
+	zoeLabel          int_state, pre_state, ext_state;
+	zoeFeature        f;
+	zoeHMM            hmm = trellis->hmm;
+	zoeFeatureBuf     sfv;
+	struct zoeJump  * jump;
+	struct rankExt    c, v;
+	
+	/*
+		external_score for every rank: each state keeps the k best of its
+		extended internal scores and of every candidate joined to every
+		rank of its pre-state, each rank with the duration from its own
+		entry. Rank 0 is kept as external_score would choose it, from rank
+		0 alone, so the first parse is the viterbi parse; ranks 1.. are the
+		best of the rest, and may score higher. Where the ranks of a state
+		change, the new origin of each rank is recorded in that rank's trace.
+	*/
+	
+	for (s = 0; s < trellis->slots; s++) {
+		int_state = trellis->state[s];
+		if (int_state == None) continue;
+		
+		n = 0;
+		for (r = 0; r < k; r++) {
+			if (row[r * trellis->slots + s] == MIN_SCORE) continue;
+			c.score     = row[r * trellis->slots + s];
+			c.feature   = NULL;
+			c.fscore    = 0;
+			c.pre_state = int_state;
+			c.rank      = r;
+			n = insert_rank(best, n, k, &c);
+		}
+		v.score     = row[s];
+		v.feature   = NULL;
+		v.fscore    = 0;
+		v.pre_state = int_state;
+		v.rank      = 0;
+		
+		for (m = hmm->jump_at[int_state]; m < hmm->jump_at[int_state +1]; m++) {
+			jump      = &hmm->jump[m];
+			ext_state = jump->ext_state;
+			pre_state = jump->pre_state;
+			sfv       = trellis->features[ext_state];
+			if (!(trellis->pairs[ext_state][phase_class(int_state)]
+				& (1 << phase_class(pre_state)))) continue;
+			need      = jump_classes(jump);
+			phscore1  = (jump->exonic) ? trellis->phase_in[pre_state][ext_state] : 0;
+			
+			for (j = 0; j < sfv->size; j++) {
+				f = &sfv->elem[j];
+				length = f->end - f->start +1;
 				
-				/* expected score */
-				exp_score = trellis->exp_score * (f->end - f->start +1);
-				f->score -= exp_score;
-	
-				/* 'exon' scores */
-				cscore = f->score;
-				dscore = zoeScoreDuration(hmm->dmap[f->label], length);
-								
-				/* transition scores */
-				t1score = hmm->tmap[f->label][int_state];
-				t2score = hmm->tmap[pre_state][f->label];
+				/* filters; ranks 1.. are sorted, rank 0 need not lead them */
+				if (RANK_SCORE(trellis, pre_state, 0, pos -length) == MIN_SCORE
+					&& RANK_SCORE(trellis, pre_state, 1, pos -length) == MIN_SCORE) continue;
+				if ((trellis->legal[ext_state][j] & need) != need) continue;
 				
-				/* phase scores & profile score */
-				switch (ext_state) {
-					case Einit: case Eterm: case Exon: case Esngl:
-						phscore1  = zoeScorePhase(hmm->phasepref, pre_state, ext_state, 0);
-						phscore2  = zoeScorePhase(hmm->phasepref, ext_state, int_state, f->inc5);
-						if (trellis->ext) {
-							pro_score = trellis->ext(trellis, pos, pre_state, f);
-							f->score += pro_score;
-						}
-						break;
-					default:
-						phscore1  = 0;
-						phscore2  = 0;
-						pro_score = 0;
+				/*
+					Charged as external_score charges it, on rank 0's filters,
+					so that rank 0 sees the same scores; a candidate only the
+					other ranks take is charged for this pass alone.
+				*/
+				charged = RANK_SCORE(trellis, pre_state, 0, pos -length) != MIN_SCORE
+					&& pre_state_duration_score(trellis, pre_state, 0, f->start -1) != MIN_SCORE;
+				kept    = f->score;
+				cscore  = charge_candidate(trellis, f, length);
+				pro_score = 0;
+				if (jump->exonic && trellis->ext) {
+					pro_score = trellis->ext(trellis, pos, pre_state, f);
+					f->score += pro_score;
 				}
+				phscore2 = trellis->phase_out[ext_state][int_state][(int)f->inc5];
 				
-				/* total score */
-				total_score = cscore + dscore + t1score + t2score
-					+ xscore + pre_score + phscore1 + phscore2 + pro_score;
-							
-				if (total_score > max.score) {
-					zoeDeleteFeature(max.feature);
-					max.score     = total_score;
-					max.pre_state = pre_state;
-					max.feature   = zoeCopyFeature(f);
+				for (q = 0; q < k; q++) {
+					pre_score = RANK_SCORE(trellis, pre_state, q, pos -length);
+					if (pre_score == MIN_SCORE) {
+						if (q == 0) continue;
+						break;
+					}
+					
+					/* ranks 1.. only get worse from here, whatever their durations */
+					if (q > 0 && n == k && trellis->max_dur[pre_state] != MAX_SCORE
+						&& rank_total(jump, cscore, trellis->max_dur[pre_state], pre_score,
+							phscore1, phscore2, pro_score) <= best[k-1].score) break;
+					
+					xscore = pre_state_duration_score(trellis, pre_state, q, f->start -1);
+					if (xscore == MIN_SCORE) continue;
+					
+					c.score     = rank_total(jump, cscore, xscore, pre_score,
+						phscore1, phscore2, pro_score);
+					c.feature   = f;
+					c.fscore    = f->score;
+					c.pre_state = pre_state;
+					c.rank      = q;
+					if (q == 0 && (v.score == MIN_SCORE || c.score > v.score)) v = c;
+					n = insert_rank(best, n, k, &c);
 				}
+				if (!charged) f->score = kept;
 			}
 		}
+		
+		/* rank 0 first, then the best of the others */
+		for (r = 0; r < n && !same_origin(&best[r], &v); r++);
+		if (r == n && n < k) n++;
+		if (r == n) r = n -1;
+		for (; r > 0; r--) best[r] = best[r-1];
+		best[0] = v;
+		
+		/* new ranks, recording each one that did not simply extend itself */
+		for (r = 0; r < n; r++) {
+			row[r * trellis->slots + s] = best[r].score;
+			if (best[r].feature == NULL && best[r].rank == r) continue;
+			push_trace(rank_trace(trellis, int_state, r), pos, best[r].pre_state,
+				best[r].feature, best[r].fscore, best[r].rank);
+		}
 	}
+}
+
+static score_t internal_score (zoeTrellis trellis, zoeLabel state, zoeFeature f) {
+	zoeScanner scanner;
 	
-	return max;
+	/* identical scanners share one set of cumulative sums */
+	scanner = trellis->scanner[trellis->state[trellis->same[trellis->slot[state]]]];
+	return scanner->scoref(scanner, f);
 }
 
-static zoeFeatureVec trace_trellis (zoeTrellis trellis, zoeLabel state) {
-	zoeFeatureVec sfv;
-	int           i, int_end;
-	zoeFeature    estate = NULL, istate = NULL;
-	int           trace, length;
-	score_t       expected;
+static zoeFeatureVec trace_trellis (zoeTrellis trellis, zoeLabel state, int rank) {
+	zoeFeatureVec          sfv;
+	int                    i, int_end;
+	zoeFeature             estate = NULL, istate = NULL;
+	int                    idx, length;
+	score_t                expected;
+	zoeTraceVec            vec;
+	struct zoeTraceEvent * e;
 		
 	sfv = zoeNewFeatureVec();
 		
 	i = trellis->dna->length -1 -PADDING;
 	int_end = i;
 	while (i > PADDING) {
-		i--;
-		trace = trellis->trace[state][i];
-		if (trace < 0) continue;
+		/* a feature ending on row i itself is not followed, a rank move is */
+		vec = rank_trace(trellis, state, rank);
+		idx = last_trace(vec, i);
+		if (idx != -1 && vec->elem[idx].pos == i && vec->elem[idx].label != None) idx--;
+		if (idx == -1) {
+			i = PADDING;
+			break;
+		}
+		e = &vec->elem[idx];
+		
+		/* the same internal state, held by another rank before e->pos */
+		if (e->label == None) {
+			rank = e->rank;
+			i    = e->pos -1;
+			continue;
+		}
+		i = e->pos;
 		
 		/* internal state */
 		istate = zoeNewFeature(
@@ -418,27 +1162,27 @@ static zoeFeatureVec trace_trellis (zoeTrellis trellis, zoeLabel state) {
 			i,
 			int_end,
 			'+', 0, 0, 0, 0, NULL/*, NULL*/);
-		istate->score = trellis->scanner[state]->scoref(trellis->scanner[state], istate);
+		istate->score = internal_score(trellis, state, istate);
 		zoePushFeatureVec(sfv, istate);
 		zoeDeleteFeature(istate);
 		
 		/* external state */
-		estate = trellis->keep->elem[trace];
+		estate = trace_feature(e);
 		if (estate->label == Repeat && estate->start < PADDING)
 			estate->start = PADDING; /* Repeats and PADDING conspire to madness */
 		zoePushFeatureVec(sfv, estate);
 		
 		/* update */
-		state   = trellis->jump->elem[trace];
+		state   = e->pre_state;
+		rank    = e->rank;
 		i       = estate->start -1;
 		int_end = i;
+		zoeDeleteFeature(estate);
 	}
 	if (sfv->size == 0) return sfv;
 	
-	istate = zoeNewFeature(
-		state, i, int_end, '+',
-		trellis->scanner[state]->scoref(trellis->scanner[state], istate),
-		0, 0, 0, NULL/*, NULL*/);
+	istate = zoeNewFeature(state, i, int_end, '+', 0, 0, 0, 0, NULL/*, NULL*/);
+	istate->score = internal_score(trellis, state, istate);
 	
 	zoePushFeatureVec(sfv, istate);
 	zoeDeleteFeature(istate);
@@ -691,8 +1435,416 @@ static void xdefine_trellis (zoeTrellis trellis, const zoeFeatureVec vec) {
 	}
 }
 
-static score_t expected_score (const zoeDNA dna) {
-	int     i;
+static coor_t score_lookback (const zoeTrellis trellis) {
+	coor_t            i, run, length, max;
+	zoeFeatureFactory fac;
+	zoeDNA            dna = trellis->dna;
+	
+	/* the furthest back any candidate can read a pre-state score */
+	max = PADDING +1;
+	
+	/* exons start after the previous in-frame stop */
+	fac = trellis->factory[Exon];
+	if (fac) {
+		for (i = 0; i < dna->length; i++) {
+			if (i - fac->fstop[i] + 5 > max) max = i - fac->fstop[i] + 5;
+		}
+	}
+	
+	/* repeats span a run of Ns and the base before it */
+	if (trellis->factory[Repeat]) {
+		run = 0;
+		for (i = 0; i < dna->length; i++) {
+			if (dna->s5[i] == 4) run++;
+			else                 run = 0;
+			if (run + 2 > max) max = run + 2;
+		}
+	}
+	
+	/* PolyA, Prom and TSS are single positions, see zoeMakeFeatures */
+	if (trellis->factory[PolyA] || trellis->factory[Prom] || trellis->factory[TSS]) {
+		if (2 > max) max = 2;
+	}
+	
+	/* precomputed ORFs */
+	fac = trellis->factory[ORF];
+	if (fac) {
+		for (i = 0; i < fac->orfs->size; i++) {
+			length = fac->orfs->elem[i]->end - fac->orfs->elem[i]->start +1;
+			if (length + 1 > max) max = length + 1;
+		}
+	}
+	
+	return max;
+}
+
+/* posterior probabilities: forward-backward sums over the same candidates */
+
+/*
+	Sums are doubles: a whole sequence adds up to tens of thousands of
+	bits, where a float cannot keep the forward and backward sums within
+	a fraction of a bit of each other. MIN_SCORE still means impossible.
+*/
+
+enum postSweep {POST_FORWARD, POST_BACKWARD, POST_QUERY};
+
+static double log_add (double a, double b) {
+	if (a == MIN_SCORE) return b;
+	if (b == MIN_SCORE) return a;
+	if (a > b) return a + log2(1 + exp2(b - a));
+	else       return b + log2(1 + exp2(a - b));
+}
+
+static double log_sum (const double * v, int n) {
+	int    i;
+	double max = MIN_SCORE, sum = 0;
+	
+	/* the max first so that the second pass has no branches */
+	for (i = 0; i < n; i++) if (v[i] > max) max = v[i];
+	if (max == MIN_SCORE) return MIN_SCORE;
+	for (i = 0; i < n; i++) sum += exp2(v[i] - max);
+	return max + log2(sum);
+}
+
+static void push_sum (zoeTrellis trellis, int n, double val) {
+	if (n == trellis->sums_limit) {
+		trellis->sums_limit = (n) ? n * 2 : 256;
+		trellis->sums = zoeRealloc(trellis->sums, trellis->sums_limit * sizeof(double));
+	}
+	trellis->sums[n] = val;
+}
+
+static int same_candidate (const zoeFeature f, const zoeFeature g) {
+	return f->label == g->label && f->start == g->start && f->end == g->end
+		&& f->inc5 == g->inc5 && f->inc3 == g->inc3;
+}
+
+static void sum_step (const double * prev, double * cur, const score_t * track,
+	score_t exp_score, int slots)
+{
+	int s;
+	
+	/* internal_step in doubles */
+	for (s = 0; s < slots; s++) {
+		if (prev[s] == MIN_SCORE) cur[s] = MIN_SCORE;
+		else                      cur[s] = prev[s] + (track[s] - exp_score);
+	}
+}
+
+static void add_site_posteriors (zoeTrellis trellis, const zoeFeature f, coor_t pos, float p) {
+	
+	/* the same site positions the exon factory reads */
+	switch (f->label) {
+		case Einit:
+			trellis->site[Start][f->start] += p;
+			trellis->site[Donor][pos]      += p;
+			break;
+		case Exon:
+			trellis->site[Acceptor][f->start -1] += p;
+			trellis->site[Donor][pos]            += p;
+			break;
+		case Eterm:
+			trellis->site[Acceptor][f->start -1] += p;
+			trellis->site[Stop][pos]             += p;
+			break;
+		case Esngl:
+			trellis->site[Start][f->start] += p;
+			trellis->site[Stop][pos]       += p;
+			break;
+		default: break;
+	}
+}
+
+static float posterior_row (zoeTrellis trellis, coor_t pos, int sweep, const zoeFeature match) {
+	int              j, k, s, n, pre_slot, slots = trellis->slots;
+	coor_t           x;
+	score_t          edge;
+	double           pre;
+	double         * frow = trellis->forward  + pos * slots;
+	double         * brow = trellis->backward + pos * slots;
+	float            found = 0;
+	zoeLabel         pre_state, ext_state, int_state;
+	zoeFeature       f;
+	zoeFeatureBuf    sfv;
+	zoeHMM           hmm = trellis->hmm;
+	struct zoeJump * jump;
+	
+	/*
+		Every (pre, candidate, int) path that external_score compares is
+		summed instead: the forward sweep adds them into row pos, the
+		backward sweep pushes them back to the pre-state rows, and a query
+		sums the probability of the ones matching a feature.
+	*/
+	
+	for (s = 0; s < slots; s++) {
+		int_state = trellis->state[s];
+		if (int_state == None) continue;
+		if (sweep != POST_FORWARD && brow[s] == MIN_SCORE) continue;
+		
+		n = 0;
+		if (sweep == POST_FORWARD && frow[s] != MIN_SCORE) push_sum(trellis, n++, frow[s]);
+		
+		for (k = hmm->jump_at[int_state]; k < hmm->jump_at[int_state +1]; k++) {
+			jump      = &hmm->jump[k];
+			ext_state = jump->ext_state;
+			pre_state = jump->pre_state;
+			pre_slot  = trellis->slot[pre_state];
+			sfv       = trellis->features[ext_state];
+			if (!(trellis->pairs[ext_state][phase_class(int_state)]
+				& (1 << phase_class(pre_state)))) continue;
+			
+			for (j = 0; j < sfv->size; j++) {
+				f = &sfv->elem[j];
+				if (sweep == POST_QUERY && !same_candidate(f, match)) continue;
+				x   = pos - (f->end - f->start +1);
+				pre = trellis->forward[x * slots + pre_slot];
+				if (pre == MIN_SCORE && sweep != POST_BACKWARD) continue;
+				
+				edge = edge_score(trellis, pos, ext_state, f, j, pre_state, int_state);
+				if (edge == MIN_SCORE) continue;
+				
+				switch (sweep) {
+					case POST_FORWARD:
+						push_sum(trellis, n++, pre + edge);
+						break;
+					case POST_BACKWARD:
+						trellis->backward[x * slots + pre_slot] = log_add(
+							trellis->backward[x * slots + pre_slot], edge + brow[s]);
+						if (jump->exonic && pre != MIN_SCORE) add_site_posteriors(trellis,
+							f, pos, exp2(pre + edge + brow[s] - trellis->total));
+						break;
+					default:
+						found += exp2(pre + edge + brow[s] - trellis->total);
+				}
+			}
+		}
+		
+		if (sweep == POST_FORWARD) frow[s] = log_sum(trellis->sums, n);
+	}
+	
+	return found;
+}
+
+static score_t * posterior_track (zoeTrellis trellis, coor_t i, coor_t * lo, coor_t * hi) {
+	coor_t end = trellis->dna->length - PADDING;
+	
+	/* tracks a block at a time, in either direction */
+	if (i >= *hi) {
+		*lo = i;
+		*hi = (i + TRACK_BLOCK < end) ? i + TRACK_BLOCK : end;
+		compute_tracks(trellis, *lo, *hi);
+	} else if (i < *lo) {
+		*hi = i +1;
+		*lo = (i +1 > PADDING + TRACK_BLOCK) ? i +1 - TRACK_BLOCK : PADDING;
+		compute_tracks(trellis, *lo, *hi);
+	}
+	return trellis->track + (i - *lo) * trellis->slots;
+}
+
+static void forward_sweep (zoeTrellis trellis) {
+	coor_t   i, lo = 0, hi = 0;
+	int      s, slots = trellis->slots;
+	zoeLabel j;
+	double * row;
+	
+	for (i = 0; i <= PADDING; i++) {
+		row = trellis->forward + i * slots;
+		for (s = 0; s < slots; s++) {
+			j = trellis->state[s];
+			row[s] = (j == None) ? MIN_SCORE : trellis->hmm->imap[j];
+		}
+	}
+	
+	for (i = PADDING; i < trellis->dna->length - PADDING; i++) {
+		sum_step(trellis->forward + (i-1) * slots, trellis->forward + i * slots,
+			posterior_track(trellis, i, &lo, &hi), trellis->exp_score, slots);
+		if (!trellis->event[i]) continue;
+		if (compute_external_features(trellis, i) == 0) continue;
+		posterior_row(trellis, i, POST_FORWARD, NULL);
+	}
+}
+
+static void backward_sweep (zoeTrellis trellis) {
+	coor_t   i, last, lo = 0, hi = 0;
+	int      s, n, slots = trellis->slots;
+	zoeLabel j;
+	double * row, * step;
+	
+	last = trellis->dna->length -1 -PADDING;
+	for (i = 0; i < trellis->dna->length * slots; i++) trellis->backward[i] = MIN_SCORE;
+	
+	/* the sum of every parse */
+	row = trellis->backward + last * slots;
+	for (s = 0, n = 0; s < slots; s++) {
+		j = trellis->state[s];
+		if (j == None || trellis->forward[last * slots + s] == MIN_SCORE) continue;
+		row[s] = trellis->hmm->kmap[j];
+		if (row[s] != MIN_SCORE) push_sum(trellis, n++, trellis->forward[last * slots + s] + row[s]);
+	}
+	trellis->total = log_sum(trellis->sums, n);
+	if (trellis->total == MIN_SCORE) zoeExit("no parse for posteriors");
+	
+	step = zoeMalloc(slots * sizeof(double));
+	for (i = last; i >= PADDING -1; i--) {
+		row = trellis->backward + i * slots;
+		if (i < last) {
+			sum_step(row + slots, step, posterior_track(trellis, i +1, &lo, &hi),
+				trellis->exp_score, slots);
+			for (s = 0; s < slots; s++) row[s] = log_add(row[s], step[s]);
+		}
+		if (i < PADDING || !trellis->event[i]) continue;
+		if (compute_external_features(trellis, i) == 0) continue;
+		posterior_row(trellis, i, POST_BACKWARD, NULL);
+	}
+	zoeFree(step);
+}
+
+static float exon_posterior (zoeTrellis trellis, const zoeFeature exon) {
+	coor_t pos = exon->end +1;
+	
+	if (!trellis->event[pos]) return 0;
+	if (compute_external_features(trellis, pos) == 0) return 0;
+	return posterior_row(trellis, pos, POST_QUERY, exon);
+}
+
+static int find_candidate (zoeTrellis trellis, const zoeFeature exon) {
+	int           j;
+	zoeFeatureBuf sfv = trellis->features[exon->label];
+	
+	if (!trellis->event[exon->end +1]) return -1;
+	if (compute_external_features(trellis, exon->end +1) == 0) return -1;
+	for (j = 0; j < sfv->size; j++) {
+		if (same_candidate(&sfv->elem[j], exon)) return j;
+	}
+	return -1;
+}
+
+static float intron_posterior (zoeTrellis trellis, const zoeFeature a, const zoeFeature b) {
+	int               i, j, k, s, n, slots = trellis->slots;
+	coor_t            r, x, y, xr, lo = 0, hi = 0;
+	zoeLabel          t, u, ext;
+	score_t           edge;
+	double            entry[zoeLABELS], exit[zoeLABELS], pre, * v;
+	zoeIVec           ivec;
+	zoeFeature        f;
+	zoeFeatureFactory fac;
+	zoeHMM            hmm = trellis->hmm;
+	float             p = 0;
+	
+	/*
+		The intron runs from row x after exon a to row y where exon b
+		starts. Each intron state t is entered from a, extended through
+		its internal steps and any shuttle candidates (t -> shuttle -> t),
+		and left through b.
+	*/
+	
+	x = a->end +1;
+	y = b->start;
+	for (s = 0; s < slots; s++) entry[s] = exit[s] = MIN_SCORE;
+	
+	if ((j = find_candidate(trellis, a)) == -1) return 0;
+	f = &trellis->features[a->label]->elem[j];
+	for (s = 0; s < slots; s++) {
+		t = trellis->state[s];
+		if (t == None || hmm->jmap[t][a->label] == NULL) continue;
+		ivec = hmm->jmap[t][a->label];
+		for (i = 0, n = 0; i < ivec->size; i++) {
+			pre = trellis->forward[a->start * slots + trellis->slot[ivec->elem[i]]];
+			if (pre == MIN_SCORE) continue;
+			edge = edge_score(trellis, x, a->label, f, j, ivec->elem[i], t);
+			if (edge != MIN_SCORE) push_sum(trellis, n++, pre + edge);
+		}
+		entry[s] = log_sum(trellis->sums, n);
+	}
+	
+	if ((j = find_candidate(trellis, b)) == -1) return 0;
+	f = &trellis->features[b->label]->elem[j];
+	for (s = 0; s < slots; s++) {
+		t = trellis->state[s];
+		if (t == None || entry[s] == MIN_SCORE) continue;
+		for (k = 0, n = 0; k < slots; k++) {
+			u = trellis->state[k];
+			if (u == None || hmm->jmap[u][b->label] == NULL) continue;
+			if (trellis->backward[(b->end +1) * slots + k] == MIN_SCORE) continue;
+			ivec = hmm->jmap[u][b->label];
+			for (i = 0; i < ivec->size; i++) {
+				if (ivec->elem[i] != t) continue;
+				edge = edge_score(trellis, b->end +1, b->label, f, j, t, u);
+				if (edge == MIN_SCORE) continue;
+				push_sum(trellis, n++, edge + trellis->backward[(b->end +1) * slots + k]);
+			}
+		}
+		exit[s] = log_sum(trellis->sums, n);
+	}
+	
+	v = zoeMalloc((y - x +1) * sizeof(double));
+	for (s = 0; s < slots; s++) {
+		if (entry[s] == MIN_SCORE || exit[s] == MIN_SCORE) continue;
+		t = trellis->state[s];
+		
+		v[0] = entry[s];
+		for (r = x +1; r <= y; r++) {
+			v[r-x] = v[r-x-1];
+			if (v[r-x] != MIN_SCORE) {
+				v[r-x] += posterior_track(trellis, r, &lo, &hi)[s] - trellis->exp_score;
+			}
+			if (!trellis->event[r]) continue;
+			for (ext = 0; ext < zoeLABELS; ext++) {
+				if (ext != Repeat && ext != ORF && ext != CNS) continue;
+				if (hmm->jmap[t][ext] == NULL) continue;
+				if ((fac = trellis->factory[ext]) == NULL) continue;
+				trellis->exons->size = 0;
+				if (fac->create(fac, r, trellis->exons) == 0) continue;
+				for (k = 0; k < trellis->exons->size; k++) {
+					f = &trellis->exons->elem[k];
+					if (f->start < PADDING) f->start = PADDING;
+					xr = r - (f->end - f->start +1);
+					if (xr < x || v[xr-x] == MIN_SCORE) continue;
+					edge = edge_score(trellis, r, ext, f, -1, t, t);
+					if (edge == MIN_SCORE) continue;
+					v[r-x] = log_add(v[r-x], v[xr-x] + edge);
+				}
+			}
+		}
+		
+		if (v[y-x] != MIN_SCORE) p += exp2(v[y-x] + exit[s] - trellis->total);
+	}
+	zoeFree(v);
+	
+	return p;
+}
+
+static void delete_posteriors (zoeTrellis trellis) {
+	int label;
+	
+	if (trellis->forward)  zoeFree(trellis->forward);
+	if (trellis->backward) zoeFree(trellis->backward);
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->site[label]) zoeFree(trellis->site[label]);
+		trellis->site[label] = NULL;
+	}
+	trellis->forward  = NULL;
+	trellis->backward = NULL;
+}
+
+static void push_posterior (zoeFeatureVec vec, zoeLabel label, coor_t start, coor_t end,
+	float p, const zoeFeature exon)
+{
+	zoeFeature f;
+	
+	/* padded in, unpadded out */
+	f = zoeNewFeature(label, start - PADDING, end - PADDING, '+', p,
+		exon ? exon->inc5 : 0, exon ? exon->inc3 : 0, exon ? exon->frame : 0, NULL);
+	zoePushFeatureVec(vec, f);
+	zoeDeleteFeature(f);
+}
+
+/****************************************************************************\
+ PUBLIC FUNCTIONS
+\****************************************************************************/
+
+score_t zoeExpectedScore (const zoeDNA dna) {
+	int     i;
 	int     count[5];
 	int     total = 0;
 	float   freq[4];
@@ -714,41 +1866,82 @@ static score_t expected_score (const zoeDNA dna) {
 	return exp_score;
 }
 
-/****************************************************************************\
- PUBLIC FUNCTIONS
-\****************************************************************************/
-
-
 void zoeDeleteTrellis (zoeTrellis trellis) {
-	int i;
+	int i, r;
 	
 	for (i = 0; i < zoeLABELS; i++) {
 		if (trellis->scanner[i]  != NULL) zoeDeleteScanner(trellis->scanner[i]);
-		if (trellis->trace[i]    != NULL) zoeFree(trellis->trace[i]);
-		if (trellis->score[i]    != NULL) zoeFree(trellis->score[i]);
+		if (trellis->trace[i]    != NULL) delete_trace(trellis->trace[i]);
+		if (trellis->entry[i]    != NULL) zoeFree(trellis->entry[i]);
+		if (trellis->entry_at[i] != NULL) zoeFree(trellis->entry_at[i]);
+		if (trellis->ranked[i]   != NULL) {
+			for (r = 1; r < trellis->kbest; r++) delete_trace(trellis->ranked[i][r]);
+			zoeFree(trellis->ranked[i]);
+		}
 		if (trellis->factory[i]  != NULL) zoeDeleteFeatureFactory(trellis->factory[i]);
+		if (trellis->fixed[i]    != NULL) zoeFree(trellis->fixed[i]);
+		if (trellis->legal[i]    != NULL) zoeFree(trellis->legal[i]);
+		if (trellis->features[i] != NULL) zoeDeleteFeatureBuf(trellis->features[i]);
 	}
-	
+	if (trellis->exons) zoeDeleteFeatureBuf(trellis->exons);
+	delete_posteriors(trellis);
+	if (trellis->sums) zoeFree(trellis->sums);
+	
+	if (trellis->score) zoeFree(trellis->score);
+	if (trellis->iscore) zoeFree(trellis->iscore);
+	if (trellis->itrack) zoeFree(trellis->itrack);
+	if (trellis->parse) zoeFree(trellis->parse);
+	if (trellis->track) zoeFree(trellis->track);
+	if (trellis->event) zoeFree(trellis->event);
+	if (trellis->xdef)  zoeDeleteFeatureVec(trellis->xdef);
 	zoeDeleteDNA(trellis->dna);
 	zoeDeleteDNA(trellis->anti);
-	zoeDeleteFeatureVec(trellis->keep);
-	zoeDeleteIVec(trellis->jump);
 	zoeFree(trellis);
 	
 }
 
 
-zoeTrellis zoeNewTrellis (
+static void orf_factory (zoeTrellis trellis, const zoeTrellis other) {
+	int          i;
+	zoeState     state;
+	zoeHMM       hmm = trellis->hmm;
+	int          MinimumORFScore = 0;
+	
+	/*
+		ORFs are the best exons of the opposite strand. When the other
+		strand's trellis has unmodified scanners its exon factory already
+		holds exactly those candidates, so they are not computed twice.
+	*/
+	for (i = 0; i < hmm->states; i++) {
+		state = hmm->state[i];
+		if (state->label != ORF || state->type == INTERNAL) continue;
+		if (other && other->factory[Exon] && !other->modified) {
+			trellis->factory[ORF] = zoeNewXFactoryFromEFactory(
+				other->factory[Exon], state->min, MinimumORFScore);
+		} else {
+			trellis->factory[ORF] = zoeNewXFactory(
+				trellis->scanner[Coding],
+				trellis->scanner[Acceptor],
+				trellis->scanner[Donor],
+				trellis->scanner[Start],
+				trellis->scanner[Stop],
+				state->min,
+				MinimumORFScore);
+		}
+	}
+}
+
+static zoeTrellis new_trellis (
 	const zoeDNA real_dna,
 	const zoeHMM hmm,
-	const zoeFeatureVec xdef)
+	const zoeFeatureVec xdef,
+	int orfs_first)
 {
 	int          i, label;
 	zoeState     state;
 	zoeDNA       dna, anti;
 	zoeTrellis   trellis;
 	int          MinimumRepeatLength = 10;
-	int          MinimumORFScore = 0;
 	
 	trellis = zoeMalloc(sizeof(struct zoeTrellis));
 		
@@ -756,13 +1949,26 @@ zoeTrellis zoeNewTrellis (
 	trellis->dna   = NULL;
 	trellis->hmm   = NULL;
 	trellis->ext   = NULL;
+	trellis->score = NULL;
+	trellis->iscore = NULL;
+	trellis->parse = NULL;
+	trellis->track = NULL;
+	trellis->itrack = NULL;
+	trellis->event = NULL;
+	trellis->entry_mask = -1;
+	trellis->exons = zoeNewFeatureBuf();
 	for (label = 0; label < zoeLABELS; label++) {
 		trellis->scanner[label]  = NULL;
 		trellis->trace[label]    = NULL;
-		trellis->score[label]    = NULL;
+		trellis->ranked[label]   = NULL;
+		trellis->entry[label]    = NULL;
+		trellis->entry_at[label] = NULL;
 		trellis->factory[label]  = NULL;
 		trellis->internal[label] = 0;
-		trellis->features[label] = NULL;
+		trellis->features[label] = zoeNewFeatureBuf();
+		trellis->fixed[label]    = NULL;
+		trellis->legal[label]    = NULL;
+		trellis->fixed_limit[label] = 0;
 	}
 	
 	/* initial setup */
@@ -771,11 +1977,20 @@ zoeTrellis zoeNewTrellis (
 	trellis->dna       = dna;
 	trellis->anti      = anti;
 	trellis->hmm       = hmm;
-	trellis->xdef      = xdef;
+	trellis->xdef      = NULL; /* padded copy, see xdefine_trellis */
 	trellis->max_score = MIN_SCORE;
-	trellis->exp_score = expected_score(real_dna);
-	trellis->keep      = zoeNewFeatureVec();
-	trellis->jump      = zoeNewIVec();
+	trellis->exp_score = zoeExpectedScore(real_dna);
+	trellis->pruned    = 0;
+	trellis->bounded   = 0;
+	trellis->saturated = 0;
+	trellis->modified  = 0;
+	trellis->kbest     = KBEST;
+	trellis->parses    = 0;
+	trellis->forward   = NULL;
+	trellis->backward  = NULL;
+	trellis->sums      = NULL;
+	trellis->sums_limit = 0;
+	for (label = 0; label < zoeLABELS; label++) trellis->site[label] = NULL;
 
 	/* create scanners */
 	for (label = 0; label < zoeLABELS; label++) {
@@ -785,12 +2000,20 @@ zoeTrellis zoeNewTrellis (
 	
 	/* modify scanners with arbitrary scoring filters */
 	for (label = 0; label < zoeLABELS; label++) {
-		if (zoeGetAscore(label) != 0) adefine_trellis(trellis, label);
+		if (zoeGetAscore(label) == 0) continue;
+		adefine_trellis(trellis, label);
+		trellis->modified = 1;
 	}
 	
 	/* modify scanners with external information */
-	if (xdef) xdefine_trellis(trellis, xdef);
+	if (xdef) {
+		xdefine_trellis(trellis, xdef);
+		if (xdef->size) trellis->modified = 1;
+	}
 
+	/* alone, the opposite strand's exons are freed before this one's are made */
+	if (orfs_first) orf_factory(trellis, NULL);
+	
 	/* create factories for external & shuttle states */
 	if (PROGRESS_METER) zoeE("scoring");
 	for (i = 0; i <  hmm->states; i++) {
@@ -821,21 +2044,66 @@ zoeTrellis zoeNewTrellis (
 				trellis->factory[TSS] = zoeNewSFactory(trellis->scanner[TSS], TSS);
 				break;
 			case ORF:
-				trellis->factory[ORF] = zoeNewXFactory(
-					trellis->scanner[Coding],
-					trellis->scanner[Acceptor],
-					trellis->scanner[Donor],
-					trellis->scanner[Start],
-					trellis->scanner[Stop],
-					state->min,
-					MinimumORFScore);
-				break;
+				break; /* may use the other strand, see zoeCompleteTrellis */
 			default:
 				zoeExit("zoeNewTrellis: can't make such a factory\n");
 				break;
 		}
 	}
 	
+	return trellis;
+}
+
+zoeTrellis zoeNewPartialTrellis (
+	const zoeDNA real_dna,
+	const zoeHMM hmm,
+	const zoeFeatureVec xdef)
+{
+	return new_trellis(real_dna, hmm, xdef, 0);
+}
+
+zoeTrellis zoeNewTrellis (
+	const zoeDNA real_dna,
+	const zoeHMM hmm,
+	const zoeFeatureVec xdef)
+{
+	zoeTrellis trellis = new_trellis(real_dna, hmm, xdef, 1);
+	zoeCompleteTrellis(trellis, NULL);
+	return trellis;
+}
+
+void zoeCompleteTrellis (zoeTrellis trellis, const zoeTrellis other) {
+	int          i, j, k, r, s, label, pre;
+	coor_t       columns, lookback, ring;
+	zoeState     state;
+	zoeDNA       dna = trellis->dna;
+	zoeHMM       hmm = trellis->hmm;
+	
+	if (trellis->factory[ORF] == NULL) orf_factory(trellis, other);
+	
+	/* external features can end only where some factory marks an event */
+	trellis->event = zoeCalloc(dna->length, sizeof(char));
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->factory[label] == NULL) continue;
+		trellis->factory[label]->mark(trellis->factory[label], trellis->event);
+	}
+	
+	/* entry positions always, score columns with -lowmem: rings covering the lookback */
+	lookback = score_lookback(trellis);
+	for (ring = 2; ring <= lookback; ring *= 2); /* fill_entries reads p -1 */
+	if (ring < dna->length) {
+		trellis->entry_mask = ring -1;
+	} else {
+		trellis->entry_mask = -1;
+		ring = dna->length;
+	}
+	columns = dna->length;
+	trellis->mask = -1;
+	if (LOW_MEMORY) {
+		columns = ring;
+		trellis->mask = trellis->entry_mask;
+	}
+	
 	/* trace & scores: 2D matrices */
 	for (i = 0; i < hmm->states; i++) {
 		state = hmm->state[i];
@@ -850,29 +2118,86 @@ zoeTrellis zoeNewTrellis (
 			trellis->internal[Int2TA] = 1;
 			trellis->internal[Int2TG] = 1;
 		
-			trellis->trace[Int0]   = zoeCalloc(dna->length, sizeof(int));
-			trellis->trace[Int1]   = zoeCalloc(dna->length, sizeof(int));
-			trellis->trace[Int1T]  = zoeCalloc(dna->length, sizeof(int));
-			trellis->trace[Int2]   = zoeCalloc(dna->length, sizeof(int));
-			trellis->trace[Int2TA] = zoeCalloc(dna->length, sizeof(int));
-			trellis->trace[Int2TG] = zoeCalloc(dna->length, sizeof(int));
-			
-			trellis->score[Int0]   = zoeCalloc(dna->length, sizeof(score_t));
-			trellis->score[Int1]   = zoeCalloc(dna->length, sizeof(score_t));
-			trellis->score[Int1T]  = zoeCalloc(dna->length, sizeof(score_t));
-			trellis->score[Int2]   = zoeCalloc(dna->length, sizeof(score_t));
-			trellis->score[Int2TA] = zoeCalloc(dna->length, sizeof(score_t));
-			trellis->score[Int2TG] = zoeCalloc(dna->length, sizeof(score_t));
+			trellis->trace[Int0]   = new_trace();
+			trellis->trace[Int1]   = new_trace();
+			trellis->trace[Int1T]  = new_trace();
+			trellis->trace[Int2]   = new_trace();
+			trellis->trace[Int2TA] = new_trace();
+			trellis->trace[Int2TG] = new_trace();
 			
 		} else {
 		
 			trellis->internal[state->label] = 1;
-			trellis->trace[state->label]    = zoeCalloc(dna->length, sizeof(int));
-			trellis->score[state->label]    = zoeCalloc(dna->length, sizeof(score_t));
+			trellis->trace[state->label]    = new_trace();
 
 		}
 	}
 	
+	/* score rows: internal states in label order, padded to 4 for internal_step */
+	trellis->slots = 0;
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->internal[label] == 0) continue;
+		trellis->slot[label] = trellis->slots;
+		trellis->state[trellis->slots] = label;
+		trellis->slots++;
+	}
+	while (trellis->slots % 4) trellis->state[trellis->slots++] = None;
+	map_same_scanners(trellis);
+	for (s = 0; s < trellis->slots && trellis->kbest > 1 && !LOW_MEMORY; s++) {
+		if (trellis->state[s] == None || trellis->same[s] != s) continue;
+		zoeSumScanner(trellis->scanner[trellis->state[s]]); /* every parse is traced */
+	}
+	
+	/* sites and CDS sums are scored; k-mer codes are not kept for the decoding */
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->scanner[label]) zoeDropScannerCodes(trellis->scanner[label]);
+	}
+	zoeDropKmerCodes(dna);
+	if (trellis->anti) zoeDropKmerCodes(trellis->anti);
+	trellis->width = trellis->slots * trellis->kbest;
+	if (FIXED_POINT) {
+		if (trellis->kbest > 1) zoeExit("fixed-point scores keep only the best parse");
+		trellis->iscore = zoeCalloc(columns * trellis->width, sizeof(fixed_t));
+		trellis->itrack = zoeMalloc(TRACK_BLOCK * trellis->slots * sizeof(fixed_t));
+	} else {
+		trellis->score = zoeCalloc(columns * trellis->width, sizeof(score_t));
+	}
+	trellis->parse = zoeMalloc(trellis->kbest * sizeof(struct zoeParse));
+	
+	/* rank 0 is the viterbi trace, the others have their own */
+	for (label = 0; label < zoeLABELS && trellis->kbest > 1; label++) {
+		if (trellis->trace[label] == NULL) continue;
+		trellis->ranked[label] = zoeMalloc(trellis->kbest * sizeof(zoeTraceVec));
+		trellis->ranked[label][0] = NULL;
+		for (r = 1; r < trellis->kbest; r++) trellis->ranked[label][r] = new_trace();
+	}
+	trellis->track = zoeMalloc(TRACK_BLOCK * trellis->slots * sizeof(score_t));
+	
+	/* entry positions of explicit-duration states, one ring of all ranks each */
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->internal[label] == 0) continue;
+		if (hmm->smap[label]->geometric) continue;
+		trellis->entry[label]    = zoeMalloc(ring * trellis->kbest * sizeof(coor_t));
+		trellis->entry_at[label] = zoeMalloc(trellis->kbest * sizeof(int));
+		reset_entries(trellis, label, PADDING);
+	}
+	
+	/* phase preferences of the exon transitions that external_score uses */
+	for (j = 0; j < zoeLABELS; j++) {
+		if (trellis->internal[j] == 0) continue;
+		for (label = 0; label < zoeLABELS; label++) {
+			if (hmm->jmap[j][label] == NULL) continue;
+			if (label != Einit && label != Eterm && label != Exon && label != Esngl) continue;
+			for (k = 0; k < 3; k++) {
+				trellis->phase_out[label][j][k] = zoeScorePhase(hmm->phasepref, label, j, k);
+			}
+			for (k = 0; k < hmm->jmap[j][label]->size; k++) {
+				pre = hmm->jmap[j][label]->elem[k];
+				trellis->phase_in[pre][label] = zoeScorePhase(hmm->phasepref, pre, label, 0);
+			}
+		}
+	}
+	
 	/* minimum and maximum lengths */
 	for (label = 0; label < zoeLABELS; label++) {
 		if (hmm->smap[label] == NULL) continue;
@@ -880,108 +2205,132 @@ zoeTrellis zoeNewTrellis (
 		trellis->max_len[label] = hmm->smap[label]->max;
 	}
 	
-	return trellis;
+	/* no pre-state duration scores higher, see external_score */
+	for (j = 0; j < hmm->internals; j++) {
+		label = hmm->internal[j];
+		if (hmm->smap[label]->geometric) trellis->max_dur[label] = zoeScoreDuration(hmm->dmap[label], 1);
+		else                             trellis->max_dur[label] = zoeMaxDuration(hmm->dmap[label]);
+	}
+	
+	trellis->resume = PADDING;
 }
 
+static coor_t first_xdef_change (const zoeFeatureVec old, const zoeFeatureVec new, coor_t none) {
+	int        i, k;
+	coor_t     from = none;
+	zoeFeature f, g;
+	
+	/* old is padded, new is not; a shared prefix leaves every score alone */
+	for (k = 0; old && new && k < old->size && k < new->size; k++) {
+		f = old->elem[k];
+		g = new->elem[k];
+		if (f->label != g->label || f->strand != g->strand || f->score != g->score
+			|| f->start != g->start + PADDING || f->end != g->end + PADDING
+			|| strcmp(f->group ? f->group : "", g->group ? g->group : "")) break;
+	}
+	for (i = k; old && i < old->size; i++) {
+		if (old->elem[i]->start < from) from = old->elem[i]->start;
+	}
+	for (i = k; new && i < new->size; i++) {
+		if (new->elem[i]->start + PADDING < from) from = new->elem[i]->start + PADDING;
+	}
+	
+	return (from < PADDING) ? PADDING : from;
+}
 
-zoeVec zoePredictGenes (zoeTrellis trellis) {
-	coor_t          i;           /* iterator for sequence */
-	int             j;           /* iterator for internal states */
-	score_t         iscore;      /* score of internal path */
-	zoeHMM          hmm = trellis->hmm;
-	zoeDNA          dna = trellis->dna;
-	zoeFeatureTable table;
-	zoeFeatureVec   features;
-	zoeVec          genes;
-	zoeCDS          gene;
-	zoeLabel        max_state;
-	score_t         max_score;
-	score_t         terminal_score;
-	struct maxExt   emax;
-	int             progress;
-	int             percent;
-			
-	/*-------------------------------------------------*
-	 |             [0] [1] [2] [3] [4] [5] [6] [7] ... |
-	 | (None)  [0]                                     |
-	 | (Inter) [1]              X                      |
-	 | (...)   [2]                                     |
-	 | :                  X = trellis->cell[1][3]      |
-	 | :                               cell[j][i]      |
-	 *-------------------------------------------------*/
-	 	 	
-	/* initialization */
-	for (j = 0; j < zoeLABELS; j++) {
-		if (trellis->internal[j] == 0) continue;
-		for (i = 0; i <= PADDING; i++) {
-			trellis->score[j][i] = hmm->imap[j];
-			trellis->trace[j][i]  = -1;
-		}
+void zoeRedefineTrellis (zoeTrellis trellis, const zoeFeatureVec xdef) {
+	coor_t      from, end, upto;
+	int         label, r;
+	zoeTraceVec vec;
+	
+	/*
+		Scores before the first changed xdef position cannot change, so
+		the rows and trace-back events before it are kept and the next
+		zoePredictGenes resumes there. Everything downstream, including
+		the exon candidates, is recomputed from the new scores.
+	*/
+	
+	if (trellis->mask != (coor_t)-1) {
+		zoeExit("zoeRedefineTrellis needs every score row (no low memory mode)");
 	}
 	
-	/* induction */
-	if (PROGRESS_METER) zoeE("decoding");
-	progress = dna->length / 20;
-	percent = 0;
+	end  = trellis->dna->length - PADDING;
+	from = first_xdef_change(trellis->xdef, xdef, end);
 	
-	for (i = PADDING; i < dna->length - PADDING; i++) {
+	/* scanners get -A and the new xdef only */
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->scanner[label]) zoeClearScannerScores(trellis->scanner[label]);
+	}
+	trellis->modified = 0;
+	for (label = 0; label < zoeLABELS; label++) {
+		if (zoeGetAscore(label) == 0) continue;
+		adefine_trellis(trellis, label);
+		trellis->modified = 1;
+	}
+	if (trellis->xdef) zoeDeleteFeatureVec(trellis->xdef);
+	trellis->xdef = NULL;
+	if (xdef) {
+		xdefine_trellis(trellis, xdef);
+		if (xdef->size) trellis->modified = 1;
+	}
+	map_same_scanners(trellis);
+	
+	/* factories and events from the first change onward */
+	if (trellis->factory[Exon]) {
+		zoeRescoreEFactory(trellis->factory[Exon],
+			trellis->scanner[Coding],
+			trellis->scanner[Acceptor],
+			trellis->scanner[Donor],
+			trellis->scanner[Start],
+			trellis->scanner[Stop],
+			from);
+	}
+	memset(trellis->event, 0, trellis->dna->length);
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->factory[label] == NULL) continue;
+		trellis->factory[label]->mark(trellis->factory[label], trellis->event);
+	}
 	
-		if (PROGRESS_METER && i % progress == 0) {
-			if (i % (progress * 2) == 0) {
-				percent += 10;
-				zoeE("%d", percent);
-			} else {
-				zoeE(".");
-			}
+	/* forget the trace-back past the change */
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->trace[label] == NULL) continue;
+		for (r = 0; r < trellis->kbest; r++) {
+			vec = rank_trace(trellis, label, r);
+			vec->size = last_trace(vec, from -1) +1;
 		}
-	
-		compute_external_features(trellis, i);
+		if (trellis->entry[label] && trellis->entry_to[label] >= from) {
 		
-		for (j = 0; j < zoeLABELS; j++) {
-			if (trellis->internal[j] == 0) continue;
-						
-			iscore = internal_score(trellis, j, i);
-			emax   = external_score(trellis, i, j);
-			
-			if (iscore == MIN_SCORE && emax.score == MIN_SCORE) {
-				trellis->score[j][i] = MIN_SCORE;
-				trellis->trace[j][i]  = -1;
-			} else if (iscore == MIN_SCORE || emax.score > iscore) {
-				trellis->score[j][i] = emax.score;
-				trellis->trace[j][i]  = trellis->keep->size;
-				zoePushFeatureVec(trellis->keep, emax.feature);
-				zoePushIVec(trellis->jump, emax.pre_state);
-			} else if (emax.score == MIN_SCORE || emax.score <= iscore) {
-				trellis->score[j][i] = iscore;
-				trellis->trace[j][i]  = -1;
+			/* the ring may hold later positions, so it is read again up to the change */
+			upto = (from -1 > PADDING) ? from -1 : PADDING;
+			if (trellis->entry_mask == -1) {
+				reset_entries(trellis, label, upto);
 			} else {
-				zoeExit("um, didn't think that was possible");
+				reset_entries(trellis, label, (upto - trellis->entry_mask -1 > PADDING)
+					? upto - trellis->entry_mask -1 : PADDING);
+				fill_entries(trellis, label, upto);
 			}
-			
-			if (emax.feature) zoeDeleteFeature(emax.feature);
 		}
-		
-		delete_external_features(trellis);
 	}
-	if (PROGRESS_METER) zoeE("100");
 	
-	/* find maximum ending state */
-	max_state = None;
-	max_score = MIN_SCORE;
-	for (j = 0; j < zoeLABELS; j++) {
-		if (trellis->internal[j] == 0) continue;
-		if (hmm->kmap[j] == MIN_SCORE) continue; /* no sense computing */
-		terminal_score = hmm->kmap[j] + trellis->score[j][dna->length -1 -PADDING];
-		if (terminal_score > max_score) {
-			max_state = j;
-			max_score = terminal_score;
-		}
-	}
-	if (max_score == MIN_SCORE) zoeExit("traceback from MIN_SCORE");
-	trellis->max_score = max_score;
+	if (from < trellis->resume) trellis->resume = from;
+	trellis->max_score = MIN_SCORE;
+	trellis->parses    = 0;
+	trellis->pruned    = 0;
+	trellis->bounded   = 0;
+	delete_posteriors(trellis);
+}
+
+
+static zoeVec parse_genes (zoeTrellis trellis, const struct zoeParse * parse) {
+	int             i, j;
+	zoeDNA          dna = trellis->dna;
+	zoeFeatureTable table;
+	zoeFeatureVec   features;
+	zoeVec          genes;
+	zoeCDS          gene;
 	
 	/* get genes from trace-back */
-	features = trace_trellis(trellis, max_state);
+	features = trace_trellis(trellis, parse->state, parse->rank);
 	table    = label_genes(dna->def, features);
 	genes    = zoeGetGenes(table, dna);
 
@@ -1017,10 +2366,311 @@ zoeVec zoePredictGenes (zoeTrellis trellis) {
 	zoeDeleteFeatureVec(features);
 	zoeDeleteFeatureTable(table);
 	
+	return genes;
+}
+
+static void fixed_row (zoeTrellis trellis, coor_t i, coor_t block_row) {
+	int           j, s, slots = trellis->slots;
+	fixed_t     * row = trellis->iscore + (i & trellis->mask) * trellis->width;
+	struct maxExt emax;
+	
+	/* one column of zoePredictGenes on fixed-point rows */
+	fixed_step(trellis->iscore + ((i-1) & trellis->mask) * trellis->width, row,
+		trellis->itrack + block_row * slots, slots, &trellis->saturated);
+	
+	if (!trellis->event[i]) return;
+	if (compute_external_features(trellis, i) == 0) return;
+	
+	for (s = 0; s < slots; s++) {
+		j = trellis->state[s];
+		if (j == None) continue;
+		emax = external_fixed(trellis, i, j);
+		if (emax.fixed == MIN_FIXED) continue;
+		if (row[s] == MIN_FIXED || emax.fixed > row[s]) {
+			row[s] = emax.fixed;
+			push_trace(trellis->trace[j], i, emax.pre_state, emax.feature, emax.fscore, 0);
+		}
+	}
+}
+
+static void float_rows (zoeTrellis trellis) {
+	int    label;
+	coor_t columns;
+	
+	/* fixed-point rows saturated: start over on float rows */
+	columns = (trellis->mask == -1) ? trellis->dna->length : trellis->mask +1;
+	zoeFree(trellis->iscore);
+	zoeFree(trellis->itrack);
+	trellis->iscore = NULL;
+	trellis->itrack = NULL;
+	trellis->score  = zoeCalloc(columns * trellis->width, sizeof(score_t));
+	
+	for (label = 0; label < zoeLABELS; label++) {
+		if (trellis->trace[label] == NULL) continue;
+		trellis->trace[label]->size = 0;
+		if (trellis->entry[label] == NULL) continue;
+		reset_entries(trellis, label, PADDING);
+	}
+	trellis->resume    = PADDING;
+	trellis->pruned    = 0;
+	trellis->bounded   = 0;
+	trellis->saturated = 0;
+	trellis->parses    = 0;
+}
+
+zoeVec zoePredictGenes (zoeTrellis trellis) {
+	coor_t          i;           /* iterator for sequence */
+	int             j, m, r, s;  /* iterators for internal states and ranks */
+	score_t       * row;         /* scores of all internal states at i */
+	fixed_t       * irow;        /* the same in fixed-point mode */
+	fixed_t         end_score, best_end = MIN_FIXED;
+	coor_t          to;
+	zoeHMM          hmm = trellis->hmm;
+	zoeDNA          dna = trellis->dna;
+	zoeVec          genes;
+	score_t         terminal_score;
+	struct maxExt   emax;
+	struct rankExt * best = NULL;
+	int             progress;
+	int             percent;
+			
+	/*-------------------------------------------------*
+	 |           (Inter) (Int0) (Int1) ...  (padding)  |
+	 | [0]                                             |
+	 | [1]                  X                          |
+	 | [2]                                             |
+	 | :        X = SCORE(trellis, Int0, 1)            |
+	 | :          = score[1 * width + slot[Int0]]      |
+	 *-------------------------------------------------*/
+	 	 	
+	/* initialization, unless resuming after zoeRedefineTrellis */
+	for (i = 0; i <= PADDING && trellis->resume == PADDING; i++) {
+		if (trellis->iscore) {
+			irow = trellis->iscore + (i & trellis->mask) * trellis->width;
+			for (s = 0; s < trellis->width; s++) {
+				j = trellis->state[s];
+				irow[s] = (j == None) ? MIN_FIXED : zoeScore2Fixed(hmm->imap[j]);
+			}
+			continue;
+		}
+		row = trellis->score + (i & trellis->mask) * trellis->width;
+		for (s = 0; s < trellis->width; s++) {
+			j = trellis->state[s % trellis->slots];
+			row[s] = (j == None || s >= trellis->slots) ? MIN_SCORE : hmm->imap[j];
+		}
+	}
+	if (trellis->kbest > 1) best = zoeMalloc(trellis->kbest * sizeof(struct rankExt));
+	
+	/* induction */
+	if (PROGRESS_METER) zoeE("decoding");
+	progress = dna->length / 20;
+	percent = 0;
+	
+	for (i = trellis->resume; i < dna->length - PADDING; i++) {
+	
+		if (PROGRESS_METER && i % progress == 0) {
+			if (i % (progress * 2) == 0) {
+				percent += 10;
+				zoeE("%d", percent);
+			} else {
+				zoeE(".");
+			}
+		}
+	
+		/* internal states: extend every state (and rank) from the previous row */
+		if ((i - trellis->resume) % TRACK_BLOCK == 0) {
+			to = (i + TRACK_BLOCK < dna->length - PADDING) ? i + TRACK_BLOCK : dna->length - PADDING;
+			compute_tracks(trellis, i, to);
+			if (trellis->iscore) fixed_tracks(trellis, to - i);
+		}
+		if (trellis->iscore) {
+			fixed_row(trellis, i, (i - trellis->resume) % TRACK_BLOCK);
+			if (trellis->saturated) break;
+			continue;
+		}
+		row = trellis->score + (i & trellis->mask) * trellis->width;
+		for (r = 0; r < trellis->kbest; r++) {
+			internal_step(trellis->score + ((i-1) & trellis->mask) * trellis->width
+				+ r * trellis->slots, row + r * trellis->slots,
+				trellis->track + ((i - trellis->resume) % TRACK_BLOCK) * trellis->slots,
+				trellis->exp_score, trellis->slots);
+		}
+		
+		/* between events the internal step is the whole column */
+		if (!trellis->event[i]) continue;
+		
+		/* external states: replace the internal score when better */
+		if (compute_external_features(trellis, i) == 0) continue;
+		
+		if (best) {
+			external_kbest(trellis, i, row, best);
+			continue;
+		}
+		
+		for (s = 0; s < trellis->slots; s++) {
+			j = trellis->state[s];
+			if (j == None) continue;
+			
+			emax = external_score(trellis, i, j, row[s]);
+			
+			if (emax.score == MIN_SCORE) continue;
+			if (row[s] == MIN_SCORE || emax.score > row[s]) {
+				row[s] = emax.score;
+				push_trace(trellis->trace[j], i, emax.pre_state, emax.feature, emax.fscore, 0);
+			}
+		}
+	}
+	if (PROGRESS_METER) zoeE("100");
+	trellis->resume = dna->length - PADDING; /* every row is final now */
+	if (best) zoeFree(best);
+	
+	/* find the best ending states (and ranks) */
+	trellis->parses = 0;
+	for (m = 0; m < hmm->internals && trellis->iscore && !trellis->saturated; m++) {
+		j = hmm->internal[m];
+		if (hmm->kmap[j] == MIN_SCORE) continue;
+		if (FIXED_SCORE(trellis, j, dna->length -1 -PADDING) == MIN_FIXED) continue;
+		end_score = fixed_add(zoeScore2Fixed(hmm->kmap[j]),
+			FIXED_SCORE(trellis, j, dna->length -1 -PADDING), &trellis->saturated);
+		if (trellis->parses && end_score <= best_end) continue;
+		best_end = end_score;
+		trellis->parse[0].score = zoeFixed2Score(end_score);
+		trellis->parse[0].state = j;
+		trellis->parse[0].rank  = 0;
+		trellis->parses = 1;
+	}
+	if (trellis->saturated) {
+		zoeWarn("fixed-point scores saturated at %d, decoding with floats", i - PADDING);
+		float_rows(trellis);
+		return zoePredictGenes(trellis);
+	}
+	for (m = 0; m < hmm->internals && !trellis->iscore; m++) {
+		j = hmm->internal[m];
+		if (hmm->kmap[j] == MIN_SCORE) continue; /* no sense computing */
+		if (RANK_SCORE(trellis, j, 0, dna->length -1 -PADDING) == MIN_SCORE) continue;
+		terminal_score = hmm->kmap[j] + RANK_SCORE(trellis, j, 0, dna->length -1 -PADDING);
+		if (trellis->parses && terminal_score <= trellis->parse[0].score) continue;
+		trellis->parse[0].score = terminal_score;
+		trellis->parse[0].state = j;
+		trellis->parse[0].rank  = 0;
+		trellis->parses = 1;
+	}
+	if (trellis->parses == 0) zoeExit("traceback from MIN_SCORE");
+	
+	/* the viterbi parse first, as external_kbest keeps rank 0, then the best others */
+	for (m = 0; m < hmm->internals && trellis->kbest > 1; m++) {
+		j = hmm->internal[m];
+		if (hmm->kmap[j] == MIN_SCORE) continue;
+		for (r = 0; r < trellis->kbest; r++) {
+			if (r == 0 && j == trellis->parse[0].state) continue;
+			if (RANK_SCORE(trellis, j, r, dna->length -1 -PADDING) == MIN_SCORE) {
+				if (r == 0) continue;
+				break;
+			}
+			terminal_score = hmm->kmap[j] + RANK_SCORE(trellis, j, r, dna->length -1 -PADDING);
+			if (trellis->parses == trellis->kbest
+				&& terminal_score <= trellis->parse[trellis->parses -1].score) {
+				if (r == 0) continue;
+				break;
+			}
+			for (s = trellis->parses; s > 1 && trellis->parse[s-1].score < terminal_score; s--) {
+				if (s < trellis->kbest) trellis->parse[s] = trellis->parse[s-1];
+			}
+			trellis->parse[s].score = terminal_score;
+			trellis->parse[s].state = j;
+			trellis->parse[s].rank  = r;
+			if (trellis->parses < trellis->kbest) trellis->parses++;
+		}
+	}
+	trellis->max_score = trellis->parse[0].score;
+	
+	genes = parse_genes(trellis, &trellis->parse[0]);
+	
 	if (PROGRESS_METER) zoeE(" done\n");
 	return genes;
 }
 
+zoeVec zoeGetParseGenes (zoeTrellis trellis, int n) {
+	if (n < 0 || n >= trellis->parses) return NULL;
+	return parse_genes(trellis, &trellis->parse[n]);
+}
+
+void zoeComputePosteriors (zoeTrellis trellis) {
+	int    label, pruned = trellis->pruned;
+	coor_t length = trellis->dna->length;
+	
+	/*
+		Forward and backward sums of every parse in log2, over the same
+		candidates, filters and beam as zoePredictGenes. Explicit durations
+		use the viterbi entry of the pre-state, so call this after
+		zoePredictGenes. Kept until zoeRedefineTrellis.
+	*/
+	
+	if (trellis->forward) return;
+	
+	if (PROGRESS_METER) zoeE("posteriors");
+	trellis->forward  = zoeMalloc(length * trellis->slots * sizeof(double));
+	trellis->backward = zoeMalloc(length * trellis->slots * sizeof(double));
+	for (label = 0; label < zoeLABELS; label++) {
+		if (label != Acceptor && label != Donor && label != Start && label != Stop) continue;
+		trellis->site[label] = zoeCalloc(length, sizeof(score_t));
+	}
+	forward_sweep(trellis);
+	backward_sweep(trellis);
+	trellis->pruned = pruned; /* already counted once */
+	if (PROGRESS_METER) zoeE(" done\n");
+}
+
+void zoeGenePosteriors (zoeTrellis trellis, zoeCDS gene) {
+	int        i;
+	zoeFeature e, prev = NULL;
+	struct zoeFeature exon, last;
+	
+	/*
+		Posterior probability of each exon, intron and splice site of a
+		gene from this trellis, as feature scores in gene->post. Sites
+		are reported where the exon factory reads them. The candidates
+		end before the stop codon that label_genes adds to the gene.
+	*/
+	
+	zoeComputePosteriors(trellis);
+	if (gene->post) zoeDeleteFeatureVec(gene->post);
+	gene->post = zoeNewFeatureVec();
+	
+	for (i = 0; i < gene->exons->size; i++) {
+		e = gene->exons->elem[i];
+		exon = *e;
+		exon.start += PADDING;
+		exon.end   += PADDING;
+		if (exon.label == Eterm || exon.label == Esngl) exon.end -= 3;
+		
+		if (prev) {
+			push_posterior(gene->post, Intron, last.end +1, exon.start -1,
+				intron_posterior(trellis, &last, &exon), NULL);
+		}
+		
+		if (exon.label == Einit || exon.label == Esngl) {
+			push_posterior(gene->post, Start, exon.start, exon.start,
+				trellis->site[Start][exon.start], NULL);
+		} else if (exon.label == Exon || exon.label == Eterm) {
+			push_posterior(gene->post, Acceptor, exon.start -1, exon.start -1,
+				trellis->site[Acceptor][exon.start -1], NULL);
+		}
+		push_posterior(gene->post, exon.label, exon.start, e->end + PADDING,
+			exon_posterior(trellis, &exon), &exon);
+		if (exon.label == Einit || exon.label == Exon) {
+			push_posterior(gene->post, Donor, exon.end +1, exon.end +1,
+				trellis->site[Donor][exon.end +1], NULL);
+		} else if (exon.label == Eterm || exon.label == Esngl) {
+			push_posterior(gene->post, Stop, exon.end +1, exon.end +1,
+				trellis->site[Stop][exon.end +1], NULL);
+		}
+		
+		prev = e;
+		last = exon;
+	}
+}
+
 void zoeScoreCDS (zoeTrellis t, zoeCDS cds, int padded, int error_ok) {
 	int i;
 	
@@ -1045,10 +2695,33 @@ void zoeSetTrellisPadding (int val) {
 	PADDING = val;
 }
 
+score_t zoeGetTrellisScore (const zoeTrellis trellis, zoeLabel state, coor_t i) {
+	if (trellis->iscore) return zoeFixed2Score(FIXED_SCORE(trellis, state, i));
+	return SCORE(trellis, state, i);
+}
+
+void zoeSetTrellisLowMemory (int val) {
+	LOW_MEMORY = val;
+}
+
+void zoeSetTrellisFixedPoint (int val) {
+	FIXED_POINT = val;
+}
+
+void zoeSetTrellisKBest (int val) {
+	KBEST = (val < 1) ? 1 : val;
+}
+
+void zoeSetTrellisBeam (score_t width, score_t floor) {
+	BEAM       = 1;
+	BEAM_WIDTH = width;
+	BEAM_FLOOR = floor;
+}
+
 char* zoeGetPartialProtein (zoeTrellis trellis, zoeLabel pre_state, zoeFeature last_exon) {
 	zoeFeatureVec sfv;
 	zoeFeature    feature, exon;
-	int           i, j, idx, trace, tx_length;
+	int           i, j, idx, tx_length;
 	char          *tx, *aa;	
 	
 	/* get exons */
@@ -1056,10 +2729,9 @@ char* zoeGetPartialProtein (zoeTrellis trellis, zoeLabel pre_state, zoeFeature l
 	zoePushFeatureVec(sfv, last_exon);
 	i = last_exon->start;
 	while (i > PADDING) {
-		i--;
-		trace = trellis->trace[pre_state][i];
-		if (trace < 0) continue;
-		feature = trellis->keep->elem[trace];
+		idx = last_trace(trellis->trace[pre_state], i -1);
+		if (idx == -1) break;
+		feature = trace_feature(&trellis->trace[pre_state]->elem[idx]);
 		switch (feature->label) {
 			case Einit:
 			case Eterm:
@@ -1068,8 +2740,9 @@ char* zoeGetPartialProtein (zoeTrellis trellis, zoeLabel pre_state, zoeFeature l
 			default: break;
 		}
 		
-		pre_state  = trellis->jump->elem[trace];
+		pre_state  = trellis->trace[pre_state]->elem[idx].pre_state;
 		i          = feature->start -1;
+		zoeDeleteFeature(feature);
 	}
 	if (sfv->size == 0) return NULL;
 		
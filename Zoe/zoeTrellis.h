@@ -43,6 +43,35 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 #include "zoeFeatureTable.h"
 #include "zoeTools.h"
 
+#define PHASE_CLASSES 7 /* Int0 .. Int2TG and states without phase */
+
+struct zoeTraceEvent {
+	coor_t   pos;       /* position where the internal state was entered */
+	zoeLabel pre_state; /* internal state before the external feature */
+	zoeLabel label;     /* external feature that caused the entry, None if ranks moved */
+	int      rank;      /* rank of the score taken from pos -1 or the pre-state */
+	coor_t   start;
+	coor_t   end;
+	score_t  score;
+	frame_t  inc5;
+	frame_t  inc3;
+	frame_t  frame;
+	strand_t strand;
+};
+
+struct zoeTraceVec {
+	struct zoeTraceEvent * elem; /* sorted by pos */
+	int                    size;
+	int                    limit;
+};
+typedef struct zoeTraceVec * zoeTraceVec;
+
+struct zoeParse {
+	score_t  score;     /* terminal score */
+	zoeLabel state;     /* internal state at the end of the sequence */
+	int      rank;      /* rank of that state's score */
+};
+
 struct zoeTrellis {
 	zoeDNA              dna;
 	zoeDNA              anti;
@@ -50,28 +79,75 @@ struct zoeTrellis {
 	zoeFeatureVec       xdef;
 	score_t             max_score;           /* set at the end */
 	score_t             exp_score;           /* expected score of null model */
-	zoeFeatureVec       keep;                /* max features */
-	zoeIVec             jump;                /* trace-back */
+	int                 pruned;              /* exon candidates dropped by the beam */
+	int                 bounded;             /* candidate scores external_score skipped */
+	int                 saturated;           /* a fixed-point sum left the range */
+	int                 modified;            /* scanners changed by -A or xdef */
+	coor_t              resume;              /* first row zoePredictGenes computes */
 	int                 min_len[zoeLABELS];  /* minimum length (internal & external) */
 	int                 max_len[zoeLABELS];  /* maximum explicit length (internal only) */
+	score_t             max_dur[zoeLABELS];  /* highest duration score (internal only) */
 	zoeScanner          scanner[zoeLABELS];  /* map hmm models to scanners here */
 	zoeFeatureFactory   factory[zoeLABELS];  /* external feature factory */
 	int                 internal[zoeLABELS]; /* internal states used */	
-	int               * trace[zoeLABELS];    /* viterbi trace-back */
-	score_t           * score[zoeLABELS];    /* viterbi score */
-	zoeFeatureVec       features[zoeLABELS]; /* current features[state_label] */
+	zoeTraceVec         trace[zoeLABELS];    /* viterbi trace-back events */
+	zoeTraceVec       * ranked[zoeLABELS];   /* trace-back of ranks 1.., if kbest > 1 */
+	coor_t            * entry[zoeLABELS];    /* last entry by position and rank, explicit states */
+	coor_t              entry_to[zoeLABELS]; /* entry[] is set up to here */
+	int               * entry_at[zoeLABELS]; /* trace events of each rank read into entry[] */
+	coor_t              entry_mask;          /* entry[] is a ring covering the lookback */
+	score_t           * score;               /* viterbi score rows, see zoeGetTrellisScore */
+	fixed_t           * iscore;              /* fixed-point rows instead, or NULL */
+	coor_t              mask;                /* -1 unless score rows are a ring */
+	int                 kbest;               /* scores kept per state and position */
+	int                 slots;               /* internal states, padded */
+	int                 width;               /* row width: slots for each rank */
+	int                 slot[zoeLABELS];     /* column of each internal state */
+	zoeLabel            state[zoeLABELS];    /* state in each column, None if padding */
+	int                 same[zoeLABELS];     /* column whose scanner is identical */
+	score_t           * track;               /* content + extension, a block of rows */
+	fixed_t           * itrack;              /* the same, fixed-point, less expected */
+	char              * event;               /* positions where a factory may emit */
+	zoeFeatureBuf       features[zoeLABELS]; /* candidates ending at the current position */
+	zoeFeatureBuf       exons;               /* EFactory output before filtering */
+	score_t           * fixed[zoeLABELS];    /* candidate-only score, per feature */
+	int               * legal[zoeLABELS];    /* phase classes around each feature */
+	int                 fixed_limit[zoeLABELS];
+	int                 pairs[zoeLABELS][PHASE_CLASSES]; /* classes, by following class */
+	score_t             phase_in[zoeLABELS][zoeLABELS];     /* [pre][exon] */
+	score_t             phase_out[zoeLABELS][zoeLABELS][3]; /* [exon][int][inc5] */
+	struct zoeParse   * parse;               /* best parses, set at the end */
+	int                 parses;
+	double            * forward;             /* log2 sums of all parses, see zoeComputePosteriors */
+	double            * backward;
+	double              total;               /* log2 sum of every parse */
+	score_t           * site[zoeLABELS];     /* Acceptor, Donor, Start & Stop posteriors */
+	double            * sums;                /* log-sum-exp buffer */
+	int                 sums_limit;
 	score_t          (* ext)(struct zoeTrellis *, coor_t, zoeLabel, zoeFeature);
 };
 typedef struct zoeTrellis * zoeTrellis;
 
 void       zoeDeleteTrellis (zoeTrellis);
 zoeTrellis zoeNewTrellis (zoeDNA, zoeHMM, zoeFeatureVec);
+zoeTrellis zoeNewPartialTrellis (zoeDNA, zoeHMM, zoeFeatureVec);
+void       zoeCompleteTrellis (zoeTrellis, const zoeTrellis);
+void       zoeRedefineTrellis (zoeTrellis, const zoeFeatureVec);
 zoeVec     zoePredictGenes (zoeTrellis);
+zoeVec     zoeGetParseGenes (zoeTrellis, int);
+void       zoeComputePosteriors (zoeTrellis);
+void       zoeGenePosteriors (zoeTrellis, zoeCDS);
 void       zoeScoreCDS(zoeTrellis, zoeCDS, int, int);
 void       zoeSetTrellisMeter (int);
 void       zoeSetTrellisPadding (int);
+void       zoeSetTrellisLowMemory (int);
+void       zoeSetTrellisKBest (int);
+void       zoeSetTrellisFixedPoint (int);
+score_t    zoeGetTrellisScore (const zoeTrellis, zoeLabel, coor_t);
+void       zoeSetTrellisBeam (score_t, score_t);
 char*      zoeGetPartialProtein (zoeTrellis, zoeLabel, zoeFeature);
 score_t    zoeScoreExon   (zoeTrellis, zoeFeature, int, int);
 score_t    zoeScoreIntron (zoeTrellis, zoeFeature, int);
+score_t    zoeExpectedScore (const zoeDNA);
 
 #endif
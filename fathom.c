@@ -1549,6 +1549,8 @@ void score_genes (void) {
 	openData();
 	while (getData()) {
 		t = zoeNewTrellis(DNA, hmm, NULL);
+		zoeSumScanner(t->scanner[Coding]);
+		zoeSumScanner(t->scanner[Int0]);
 	
 		genes = zoeGetGenes(ANN, DNA);
 		printf(">%s\n", DNA->def);
@@ -31,21 +31,36 @@ The MIT License (MIT) - opensource.org/licenses/MIT
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "zoe.h"
 
 int    file_is_isochore (const char *);
 float  gc_fraction (const zoeDNA);
 int    dna_is_ok (const zoeDNA);
 zoeVec parse_dna (const zoeHMM, const zoeDNA, zoeFeatureTable);
+static zoeVec parse_dna_kbest (const zoeHMM, const zoeDNA, zoeFeatureTable);
 
 void   ace_output (const zoeDNA, const zoeVec);
 void   gff_output (const zoeDNA, const zoeVec);
 void   zoe_output (const zoeDNA, const zoeVec);
+static void end_session (void);
 void   help (void);
 
 score_t SNAP_OVERLAP   = 200;
 coor_t  SNAP_MIN_CDS   = 180;
 score_t SNAP_MIN_SCORE = -1000;
+coor_t  SNAP_WINDOW    = 0;      /* 0 decodes the whole sequence at once */
+coor_t  SNAP_WIN_OVER  = 100000;
+coor_t  SNAP_GAP       = 0;      /* 0 never splits at N runs */
+int     SNAP_THREADS   = 1;      /* workers decoding gap-separated segments */
+int     SNAP_SERIAL    = 0;      /* one strand trellis at a time, see -lowmem */
+int     SNAP_ROUNDS    = 1;      /* xdef sets per sequence, see -xdef-rounds */
+int     SNAP_KBEST     = 1;      /* parses reported per sequence, see -kbest */
+int     SNAP_DRAW      = 8;      /* ranks drawn for distinct parses, times -kbest */
+int     SNAP_METER     = 0; /* per-sequence progress when strands run concurrently */
+long    SNAP_PRUNED    = 0; /* exon candidates dropped by -beam */
+long    SNAP_BOUNDED   = 0; /* candidate scores skipped, no loss */
+pthread_mutex_t SNAP_LOCK = PTHREAD_MUTEX_INITIALIZER;
 char * ZOE = NULL; /* environment variable */
 
 
@@ -64,6 +79,20 @@ options:\n\
   -tx <file>      create FASTA file of transcripts\n\
   -xdef <file>    external definitions\n\
   -name <string>  name for the gene [default snap]\n\
+  -window <int>   decode in overlapping windows of this size (low memory)\n\
+  -window-overlap <int>  overlap between windows [100000]\n\
+  -lowmem         keep only the Viterbi scores still needed and decode\n\
+                  one strand at a time (same output)\n\
+  -beam <bits>    drop exons this far below the best ending at each site\n\
+  -beam-floor <bits>  drop exons scoring below this\n\
+  -split-gaps <int>  decode segments between N runs this long separately\n\
+  -threads <int>  number of segments decoded at once [1]; -threads 1\n\
+                  also decodes the strands one at a time\n\
+  -xdef-rounds <int>  decode each sequence once per xdef set, reusing work\n\
+  -kbest <int>    report the <int> best parses of each sequence with\n\
+                  distinct genes [1]; the first is the usual prediction\n\
+  -post <file>    posterior probabilities of the exons, introns and sites\n\
+  -fixed          decode with fixed-point integer scores\n\
 ";
 
 /*
@@ -82,12 +111,13 @@ int main (int argc, char *argv[]) {
 	zoeHMM          hmm;
 	zoeIsochore     iso;
 	zoeCDS          gene;
-	zoeVec          genes;
-	int             label, i;
+	zoeVec          genes, parses;
+	int             label, i, j, p, round;
 	char            option[34], name[32];
 	FILE          * aa_stream = NULL;
 	FILE          * tx_stream = NULL;
 	FILE          * xd_stream  = NULL;
+	FILE          * post_stream = NULL;
 	
 	/* set the program name */
 	zoeSetProgramName(argv[0]);
@@ -103,6 +133,17 @@ int main (int argc, char *argv[]) {
 	zoeSetOption("-aa",      1);
 	zoeSetOption("-tx",      1);
 	zoeSetOption("-xdef",    1);
+	zoeSetOption("-window",  1);
+	zoeSetOption("-window-overlap", 1);
+	zoeSetOption("-lowmem",  0);
+	zoeSetOption("-beam",    1);
+	zoeSetOption("-beam-floor", 1);
+	zoeSetOption("-split-gaps", 1);
+	zoeSetOption("-threads", 1);
+	zoeSetOption("-xdef-rounds", 1);
+	zoeSetOption("-kbest",   1);
+	zoeSetOption("-post",    1);
+	zoeSetOption("-fixed",   0);
 	
 	/* unadvertised options for my own use/testing */
 	zoeSetOption("-name",      1);
@@ -149,13 +190,82 @@ int main (int argc, char *argv[]) {
 	}
 	
 	/* quiet */
-	if (zoeOption("-quiet")) zoeSetTrellisMeter(0);
+	if (zoeOption("-quiet")) {
+		zoeSetTrellisMeter(0);
+	} else if (!zoeOption("-plus") && !zoeOption("-minus") &&
+			!zoeOption("-debug") && !zoeOption("-xdebug")) {
+		/* strands are decoded concurrently, trellis meters would interleave */
+		zoeSetTrellisMeter(0);
+		SNAP_METER = 1;
+	}
 	
 	/* others */
 	if (zoeOption("-overlap")) SNAP_OVERLAP = atof(zoeOption("-overlap"));
 	if (zoeOption("-min-cds")) SNAP_MIN_CDS = atoi(zoeOption("-min-cds"));
 	if (zoeOption("-min-score")) SNAP_MIN_SCORE = atof(zoeOption("-min-score"));
 	
+	/* low memory, but -debug reports every score column */
+	if (zoeOption("-lowmem") && !zoeOption("-debug")) zoeSetTrellisLowMemory(1);
+	
+	/* beam pruning of exon candidates */
+	if (zoeOption("-beam") && atof(zoeOption("-beam")) <= 0) {
+		zoeExit("-beam must be positive");
+	}
+	if (zoeOption("-beam") || zoeOption("-beam-floor")) {
+		zoeSetTrellisBeam(
+			zoeOption("-beam") ? atof(zoeOption("-beam")) : -1,
+			zoeOption("-beam-floor") ? atof(zoeOption("-beam-floor")) : MIN_SCORE);
+	}
+	
+	/* windows */
+	if (zoeOption("-window")) SNAP_WINDOW = atoi(zoeOption("-window"));
+	if (zoeOption("-window-overlap")) SNAP_WIN_OVER = atoi(zoeOption("-window-overlap"));
+	if (zoeOption("-window") && SNAP_WIN_OVER >= SNAP_WINDOW) {
+		zoeExit("-window must be larger than -window-overlap");
+	}
+	
+	/* gap-separated segments */
+	if (zoeOption("-split-gaps")) {
+		SNAP_GAP = atoi(zoeOption("-split-gaps"));
+		if (SNAP_GAP < 1) zoeExit("-split-gaps must be positive");
+	}
+	if (zoeOption("-threads")) {
+		SNAP_THREADS = atoi(zoeOption("-threads"));
+		if (SNAP_THREADS < 1) zoeExit("-threads must be positive");
+	}
+	
+	/* strands one after the other when asked for less memory or one thread */
+	if (zoeOption("-lowmem") || (zoeOption("-threads") && SNAP_THREADS == 1)) {
+		SNAP_SERIAL = 1;
+	}
+	
+	/* repeated decoding with changing hints */
+	if (zoeOption("-xdef-rounds")) {
+		SNAP_ROUNDS = atoi(zoeOption("-xdef-rounds"));
+		if (SNAP_ROUNDS < 1) zoeExit("-xdef-rounds must be positive");
+		if (!zoeOption("-xdef")) zoeExit("-xdef-rounds requires -xdef");
+		if (zoeOption("-window") || zoeOption("-split-gaps") || zoeOption("-lowmem")) {
+			zoeExit("-xdef-rounds can't be combined with -window, -split-gaps or -lowmem");
+		}
+	}
+	
+	/* alternative parses from the same decoding */
+	if (zoeOption("-kbest")) {
+		SNAP_KBEST = atoi(zoeOption("-kbest"));
+		if (SNAP_KBEST < 1) zoeExit("-kbest must be positive");
+		if (SNAP_KBEST > 1 && (zoeOption("-window") || zoeOption("-split-gaps")
+			|| zoeOption("-xdef-rounds"))) {
+			zoeExit("-kbest above 1 can't be combined with -window, -split-gaps or -xdef-rounds");
+		}
+		zoeSetTrellisKBest(SNAP_KBEST);
+	}
+	
+	/* integer decoding */
+	if (zoeOption("-fixed")) {
+		if (SNAP_KBEST > 1) zoeExit("-fixed can't be combined with -kbest");
+		zoeSetTrellisFixedPoint(1);
+	}
+	
 	/* -flatN and -boostN */
 	if (zoeOption("-flatN") && zoeOption("-boostN")) {
 		zoeExit("-flatN and -boostN are mutually incompatible");
@@ -216,6 +326,11 @@ int main (int argc, char *argv[]) {
 			zoeExit("error opening -tx file");
 		}
 	}
+	if (zoeOption("-post")) {
+		if ((post_stream = fopen(zoeOption("-post"), "w")) == NULL) {
+			zoeExit("error opening -post file");
+		}
+	}
 	
 	/* Fasta */
 	dna_file = zoeOpenFile(argv[2]);
@@ -238,46 +353,80 @@ int main (int argc, char *argv[]) {
 			zoeLCsmooth(dna, 10, 10,100);
 		}
 				
-		/* Xdef */
-		if (zoeOption("-xdef")) {
-			xdef = zoeReadFeatureTable(xd_stream);
-		}
-		
 		/* must set isochore hmm if isochores in use */
 		if (iso) {
 			hmm = zoeSelectIsochore(iso, gc_fraction(dna));
 		}
 		
-		/* check DNA */
-		if (dna_is_ok(dna)) genes = parse_dna(hmm, dna, xdef);
-		else                genes = zoeNewVec();
+		/* one round per xdef set, each reported like a separate run */
+		for (round = 0; round < SNAP_ROUNDS; round++) {
 		
-		/* annotation output */
-		if      (zoeOption("-gff")) gff_output(dna, genes);
-		else if (zoeOption("-ace")) ace_output(dna, genes);
-		else                        zoe_output(dna, genes);
+			/* Xdef */
+			if (zoeOption("-xdef")) {
+				xdef = zoeReadFeatureTable(xd_stream);
+			}
+			
+			/* check DNA, one parse unless -kbest */
+			if (dna_is_ok(dna) && SNAP_KBEST > 1) {
+				parses = parse_dna_kbest(hmm, dna, xdef);
+			} else {
+				parses = zoeNewVec();
+				if (dna_is_ok(dna)) zoePushVec(parses, parse_dna(hmm, dna, xdef));
+				else                zoePushVec(parses, zoeNewVec());
+			}
+			
+			for (p = 0; p < parses->size; p++) {
+				genes = parses->elem[p];
+				
+				/* annotation output */
+				if      (zoeOption("-gff")) gff_output(dna, genes);
+				else if (zoeOption("-ace")) ace_output(dna, genes);
+				else                        zoe_output(dna, genes);
+				
+				/* sequence output */
+				for (i = 0; i < genes->size; i++) {
+					gene = genes->elem[i];
+					if (zoeOption("-aa")) zoeWriteProtein(aa_stream, gene->aa);
+					if (zoeOption("-tx")) zoeWriteDNA(tx_stream, gene->tx);
+				}
+				
+				/* posterior output */
+				if (post_stream) {
+					fprintf(post_stream, ">%s\n", dna->def);
+					for (i = 0; i < genes->size; i++) {
+						gene = genes->elem[i];
+						for (j = 0; gene->post && j < gene->post->size; j++) {
+							zoeWriteFeature(post_stream, gene->post->elem[j]);
+						}
+					}
+				}
 		
-		/* sequence output */
-		for (i = 0; i < genes->size; i++) {
-			gene = genes->elem[i];
-			if (zoeOption("-aa")) zoeWriteProtein(aa_stream, gene->aa);
-			if (zoeOption("-tx")) zoeWriteDNA(tx_stream, gene->tx);
+				/* clean up */
+				for (i = 0; i < genes->size; i++) zoeDeleteCDS(genes->elem[i]);
+				zoeDeleteVec(genes);
+			}
+			zoeDeleteVec(parses);
+			if (zoeOption("-xdef")) zoeDeleteFeatureTable(xdef);
 		}
-
-		/* clean up */
-		for (i = 0; i < genes->size; i++) zoeDeleteCDS(genes->elem[i]);
-		zoeDeleteVec(genes);
-		if (zoeOption("-xdef")) zoeDeleteFeatureTable(xdef);
+		end_session();
 		zoeDeleteDNA(dna);
 	}
 	
 	if (aa_stream) fclose(aa_stream);
 	if (tx_stream) fclose(tx_stream);
 	if (xd_stream) fclose(xd_stream);
+	if (post_stream) fclose(post_stream);
 	zoeCloseFile(dna_file);
 	
 	if (iso) zoeDeleteIsochore(iso);
 	else     zoeDeleteHMM(hmm);
+	
+	if ((zoeOption("-beam") || zoeOption("-beam-floor")) && !zoeOption("-quiet")) {
+		zoeE("beam pruned %ld exon candidates\n", SNAP_PRUNED);
+	}
+	if (zoeOption("-debug") && !zoeOption("-quiet")) {
+		zoeE("bounds skipped %ld candidate scores\n", SNAP_BOUNDED);
+	}
 		
 	return 0;
 }
@@ -298,6 +447,29 @@ int cmp_genes_ptr_by_start (const void * a, const void * b) {
 	return cmp_genes_by_start( *(zoeCDS *)a, *(zoeCDS *)b );
 }
 
+struct ranked_gene {
+	zoeCDS gene;
+	int    rank; /* position in the score order */
+};
+
+struct gene_pair {
+	int a; /* ranks of two overlapping genes, a < b */
+	int b;
+};
+
+int cmp_ranked_ptr_by_start (const void * a, const void * b) {
+	return ((const struct ranked_gene *)a)->gene->start
+		- ((const struct ranked_gene *)b)->gene->start;
+}
+
+int cmp_pairs (const void * a, const void * b) {
+	const struct gene_pair * p = a;
+	const struct gene_pair * q = b;
+	
+	if (p->a != q->a) return p->a - q->a;
+	return p->b - q->b;
+}
+
 void edit_names (zoeFeatureVec vec, const char * name) {
 	int        i;
 	zoeFeature f;
@@ -404,22 +576,28 @@ zoeFeatureVec get_xdef (const zoeDNA dna, const zoeFeatureTable ft, strand_t str
 
 static void debug_output (const zoeTrellis t) {
 	int i, label;
+	struct zoeTraceEvent * e;
 	
 	zoeO("TRELLIS\n");
 	for (i = 0; i < t->dna->length; i++) {
 		zoeO("%d", i);
 		for (label = 0; label < zoeLABELS; label++) {
-			if (t->score[label] == NULL) continue;
-			if (t->score[label][i] == MIN_SCORE) zoeO("\t.:.:.");
-			else zoeO("\t%d:%d", (int)t->score[label][i], t->trace[label][i]);
+			if (t->internal[label] == 0) continue;
+			if (zoeGetTrellisScore(t, label, i) == MIN_SCORE) zoeO("\t.");
+			else zoeO("\t%d", (int)zoeGetTrellisScore(t, label, i));
 		}
 		zoeO("\n");
 	}
 	
-	zoeO("KEEP\n");
-	for (i = 0; i < t->keep->size; i++) {
-		zoeO("%d:%d\t", i, t->jump->elem[i]);
-		zoeWriteFeature(stdout, t->keep->elem[i]);
+	zoeO("TRACE\n");
+	for (label = 0; label < zoeLABELS; label++) {
+		if (t->trace[label] == NULL) continue;
+		for (i = 0; i < t->trace[label]->size; i++) {
+			e = &t->trace[label]->elem[i];
+			zoeO("%d:%d:%d\t", label, e->pos, e->pre_state);
+			zoeWriteLabel(stdout, e->label);
+			zoeO("\t%d\t%d\t%g\n", e->start, e->end, e->score);
+		}
 	}
 	
 }
@@ -476,55 +654,462 @@ static void xdebug (const zoeTrellis t) {
 
 /* decoding */
 		
-zoeVec parse_strand (const zoeHMM hmm, const zoeDNA dna, const zoeFeatureTable ft, strand_t strand) {
-	zoeTrellis    trellis;
-	zoeVec        genes;
-	zoeFeatureVec vec = NULL;
+struct strand_job {
+	zoeHMM          hmm;
+	zoeDNA          dna;      /* sequence of this strand */
+	zoeFeatureTable ft;
+	strand_t        strand;
+	score_t         expected;
+	zoeFeatureVec   xdef;
+	zoeTrellis      trellis;
+	zoeTrellis      other;    /* opposite strand, or NULL */
+	zoeVec          genes;
+};
+
+static void begin_strand (struct strand_job * job) {
+	job->xdef = (zoeOption("-xdef")) ? get_xdef(job->dna, job->ft, job->strand) : NULL;
+	job->trellis = zoeNewPartialTrellis(job->dna, job->hmm, job->xdef);
+	if (job->expected != MIN_SCORE) job->trellis->exp_score = job->expected;
+}
+
+static void gene_posteriors (zoeTrellis trellis, zoeVec genes) {
+	int i;
 	
-	if (zoeOption("-xdef")) vec = get_xdef(dna, ft, strand);
-	trellis = zoeNewTrellis(dna, hmm, vec);
-		
-	genes = zoePredictGenes(trellis);
+	/* before the genes leave the trellis coordinates */
+	if (!zoeOption("-post")) return;
+	for (i = 0; i < genes->size; i++) zoeGenePosteriors(trellis, genes->elem[i]);
+}
+
+static void predict_strand (struct strand_job * job) {
+	zoeTrellis trellis = job->trellis;
+	int        i;
+	
+	job->genes = zoePredictGenes(trellis);
+	if (trellis->pruned || trellis->bounded) {
+		pthread_mutex_lock(&SNAP_LOCK);
+		SNAP_PRUNED  += trellis->pruned;
+		SNAP_BOUNDED += trellis->bounded;
+		pthread_mutex_unlock(&SNAP_LOCK);
+	}
 	if (zoeOption("-debug")) debug_output(trellis);
 	if (zoeOption("-xdebug")) xdebug(trellis);
+	gene_posteriors(trellis, job->genes);
 	
-	zoeDeleteTrellis(trellis);
-	if (vec) zoeDeleteFeatureVec(vec);
+	if (job->strand == '-') {
+		for (i = 0; i < job->genes->size; i++) {
+			zoeAntiCDS(job->genes->elem[i], job->dna->length);
+		}
+	}
+}
+
+static void finish_strand (struct strand_job * job) {
+	zoeCompleteTrellis(job->trellis, job->other);
+	predict_strand(job);
+}
+
+static void redecode_strand (struct strand_job * job) {
+	if (job->xdef) zoeDeleteFeatureVec(job->xdef);
+	job->xdef = get_xdef(job->dna, job->ft, job->strand);
+	zoeRedefineTrellis(job->trellis, job->xdef);
+	predict_strand(job);
+}
+
+static void end_strand (struct strand_job * job) {
+	zoeDeleteTrellis(job->trellis);
+	if (job->xdef) zoeDeleteFeatureVec(job->xdef);
+	if (job->strand == '-') zoeDeleteDNA(job->dna);
+}
+
+static void new_strand_job (struct strand_job * job, const zoeHMM hmm, const zoeDNA plus_dna, const zoeFeatureTable ft, strand_t strand, score_t expected) {
+	job->hmm      = hmm;
+	job->dna      = (strand == '+') ? plus_dna : zoeAntiDNA(plus_dna->def, plus_dna);
+	job->ft       = ft;
+	job->strand   = strand;
+	job->expected = expected;
+	job->xdef     = NULL;
+	job->trellis  = NULL;
+	job->other    = NULL;
+	job->genes    = NULL;
+}
+
+struct strand_run {
+	void             (* step)(struct strand_job *);
+	struct strand_job * job;
+};
+
+static void * strand_thread (void * arg) {
+	struct strand_run * run = arg;
 	
-	return genes;
+	run->step(run->job);
+	return NULL;
 }
 
-zoeVec parse_dna (const zoeHMM hmm, const zoeDNA plus_dna, zoeFeatureTable ft) {
-	zoeDNA anti_dna;
-	zoeVec plus_genes = NULL, anti_genes = NULL, genes, keep;
-	zoeCDS gene, a, b;
-	int    i, j, both_passed;
-	char   id[64], name[256];
-	
-	
-	/* plus */
-	if (zoeOption("-plus")) {
-		plus_genes = parse_strand(hmm, plus_dna, ft, '+');
-		anti_genes = zoeNewVec();
-	}
-	else if (zoeOption("-minus")) {
-		anti_dna = zoeAntiDNA(plus_dna->def, plus_dna);
-		anti_genes = parse_strand(hmm, anti_dna, ft, '-');
-		for (i = 0; i < anti_genes->size; i++) {
-			zoeAntiCDS(anti_genes->elem[i], anti_dna->length);
-		}
-		zoeDeleteDNA(anti_dna);
-		plus_genes = zoeNewVec();
+static void run_strands (void (* step)(struct strand_job *), struct strand_job * job, int count) {
+	pthread_t         thread;
+	struct strand_run run;
+	
+	/* the strands share only read-only data, the second one gets a thread */
+	if (count == 1 || zoeOption("-debug") || zoeOption("-xdebug")) {
+		/* serial so that the debugging output is not interleaved */
+		step(&job[0]);
+		if (count == 2) step(&job[1]);
+		return;
+	}
+	
+	run.step = step;
+	run.job  = &job[1];
+	if (pthread_create(&thread, NULL, strand_thread, &run) != 0) {
+		zoeExit("run_strands failed to create strand thread");
+	}
+	step(&job[0]);
+	if (pthread_join(thread, NULL) != 0) {
+		zoeExit("run_strands failed to join strand thread");
+	}
+}
+
+static int open_strands (struct strand_job * job, const zoeHMM hmm, const zoeDNA plus_dna, const zoeFeatureTable ft, score_t expected) {
+	int count = 0;
+	
+	if (!zoeOption("-minus")) new_strand_job(&job[count++], hmm, plus_dna, ft, '+', expected);
+	if (!zoeOption("-plus"))  new_strand_job(&job[count++], hmm, plus_dna, ft, '-', expected);
+	
+	/*
+		Both strands are built before either is completed, so that each
+		trellis can take its anti-strand ORFs from the other's exon
+		candidates instead of scoring the opposite strand a second time.
+	*/
+	
+	run_strands(begin_strand, job, count);
+	if (count == 2) {
+		job[0].other = job[1].trellis;
+		job[1].other = job[0].trellis;
+	}
+	run_strands(finish_strand, job, count);
+	
+	return count;
+}
+
+static void strand_genes (struct strand_job * job, int count, zoeVec * plus_genes, zoeVec * anti_genes) {
+	int i;
+	
+	*plus_genes = NULL;
+	*anti_genes = NULL;
+	for (i = 0; i < count; i++) {
+		if (job[i].strand == '+') *plus_genes = job[i].genes;
+		else                      *anti_genes = job[i].genes;
+	}
+	if (*plus_genes == NULL) *plus_genes = zoeNewVec();
+	if (*anti_genes == NULL) *anti_genes = zoeNewVec();
+}
+
+static void whole_strand (struct strand_job * job) {
+	job->xdef = (zoeOption("-xdef")) ? get_xdef(job->dna, job->ft, job->strand) : NULL;
+	job->trellis = zoeNewTrellis(job->dna, job->hmm, job->xdef); /* ORFs first */
+	if (job->expected != MIN_SCORE) job->trellis->exp_score = job->expected;
+	predict_strand(job);
+	end_strand(job);
+}
+
+static int serial_strands (struct strand_job * job, const zoeHMM hmm, const zoeDNA plus_dna, const zoeFeatureTable ft, score_t expected) {
+	int count = 0;
+	
+	/* each trellis is freed before the next is built and scores its own ORFs */
+	if (!zoeOption("-minus")) {
+		new_strand_job(&job[count], hmm, plus_dna, ft, '+', expected);
+		whole_strand(&job[count++]);
+	}
+	if (!zoeOption("-plus")) {
+		new_strand_job(&job[count], hmm, plus_dna, ft, '-', expected);
+		whole_strand(&job[count++]);
+	}
+	
+	return count;
+}
+
+static void decode_strands (const zoeHMM hmm, const zoeDNA plus_dna, const zoeFeatureTable ft, score_t expected, zoeVec * plus_genes, zoeVec * anti_genes) {
+	struct strand_job job[2];
+	int               i, count;
+	
+	if (SNAP_SERIAL) {
+		count = serial_strands(job, hmm, plus_dna, ft, expected);
+	} else {
+		count = open_strands(job, hmm, plus_dna, ft, expected);
+		for (i = 0; i < count; i++) end_strand(&job[i]);
+	}
+	strand_genes(job, count, plus_genes, anti_genes);
+}
+
+/* -xdef-rounds keeps the trellises of a sequence between its rounds */
+static struct strand_job SESSION[2];
+static int               SESSION_STRANDS = 0;
+
+static void decode_session (const zoeHMM hmm, const zoeDNA plus_dna, const zoeFeatureTable ft, zoeVec * plus_genes, zoeVec * anti_genes) {
+	int i;
+	
+	if (SESSION_STRANDS == 0) {
+		SESSION_STRANDS = open_strands(SESSION, hmm, plus_dna, ft, MIN_SCORE);
 	} else {
-		plus_genes = parse_strand(hmm, plus_dna, ft, '+');
-		anti_dna = zoeAntiDNA(plus_dna->def, plus_dna);
-		anti_genes = parse_strand(hmm, anti_dna, ft, '-');
-		for (i = 0; i < anti_genes->size; i++) {
-			zoeAntiCDS(anti_genes->elem[i], anti_dna->length);
+		for (i = 0; i < SESSION_STRANDS; i++) SESSION[i].ft = ft;
+		run_strands(redecode_strand, SESSION, SESSION_STRANDS);
+	}
+	strand_genes(SESSION, SESSION_STRANDS, plus_genes, anti_genes);
+}
+
+static void end_session (void) {
+	int i;
+	
+	for (i = 0; i < SESSION_STRANDS; i++) end_strand(&SESSION[i]);
+	SESSION_STRANDS = 0;
+}
+
+static zoeFeatureTable window_xdef (const zoeFeatureTable ft, coor_t from, coor_t length) {
+	int             i;
+	zoeFeature      f;
+	zoeFeatureVec   vec;
+	zoeFeatureTable wft;
+	
+	/* features entirely inside the window, in window coordinates */
+	vec = zoeNewFeatureVec();
+	for (i = 0; i < ft->vec->size; i++) {
+		f = ft->vec->elem[i];
+		if (f->start < from || f->end >= from + length) continue;
+		zoePushFeatureVec(vec, f);
+		vec->last->start -= from;
+		vec->last->end   -= from;
+	}
+	wft = zoeNewFeatureTable(ft->def, vec);
+	zoeDeleteFeatureVec(vec);
+	
+	return wft;
+}
+
+static void keep_window_genes (zoeVec genes, zoeVec keep, const zoeDNA dna, coor_t from, coor_t length, coor_t core_start, coor_t core_end) {
+	int    i;
+	coor_t mid;
+	zoeCDS gene;
+	
+	for (i = 0; i < genes->size; i++) {
+		gene = genes->elem[i];
+		
+		/* shift in the coordinates of the gene's own strand to keep frames */
+		if (gene->strand == '+') {
+			zoeShiftCDS(gene, from);
+		} else {
+			zoeAntiCDS(gene, length);
+			zoeShiftCDS(gene, dna->length - from - length);
+			zoeAntiCDS(gene, dna->length);
+		}
+		gene->dna = dna; /* the window DNA is about to be deleted */
+		
+		/* each gene belongs to the window whose core holds its midpoint */
+		mid = (gene->start + gene->end) / 2;
+		if (mid >= core_start && mid <= core_end) zoePushVec(keep, gene);
+		else                                      zoeDeleteCDS(gene);
+	}
+	zoeDeleteVec(genes);
+}
+
+static void decode_windows (const zoeHMM hmm, const zoeDNA dna, const zoeFeatureTable ft, score_t expected, zoeVec * plus_genes, zoeVec * anti_genes) {
+	coor_t          from, length, step, half, core_start, core_end;
+	zoeDNA          win;
+	zoeFeatureTable wft;
+	zoeVec          plus, anti;
+	
+	/*
+		Windows overlap by SNAP_WIN_OVER and the cores (the window minus
+		half of each overlap) tile the sequence. Genes are kept only by
+		the window whose core contains their midpoint, so genes cut off
+		at a window edge are replaced by the neighbouring window's call.
+		Any disagreements left in the overlaps are settled by the normal
+		overlap resolution in parse_dna.
+	*/
+	
+	*plus_genes = zoeNewVec();
+	*anti_genes = zoeNewVec();
+	if (expected == MIN_SCORE) expected = zoeExpectedScore(dna); /* null model of the whole sequence */
+	step = SNAP_WINDOW - SNAP_WIN_OVER;
+	half = SNAP_WIN_OVER / 2;
+	
+	for (from = 0; from < dna->length; from += step) {
+		length = SNAP_WINDOW;
+		if (from + length >= dna->length) length = dna->length - from;
+		
+		core_start = (from == 0) ? 0 : from + half;
+		core_end   = (from + length == dna->length) ? dna->length -1 : from + step + half -1;
+		
+		win = zoeSubseqDNA(dna->def, dna, from, length);
+		wft = (ft) ? window_xdef(ft, from, length) : NULL;
+		
+		decode_strands(hmm, win, wft, expected, &plus, &anti);
+		keep_window_genes(plus, *plus_genes, dna, from, length, core_start, core_end);
+		keep_window_genes(anti, *anti_genes, dna, from, length, core_start, core_end);
+		
+		if (wft) zoeDeleteFeatureTable(wft);
+		zoeDeleteDNA(win);
+		if (SNAP_METER) zoeE(".");
+		
+		if (from + length == dna->length) break;
+	}
+}
+
+static void decode_region (const zoeHMM hmm, const zoeDNA dna, const zoeFeatureTable ft, score_t expected, zoeVec * plus_genes, zoeVec * anti_genes) {
+	if (SNAP_WINDOW && dna->length > SNAP_WINDOW) {
+		decode_windows(hmm, dna, ft, expected, plus_genes, anti_genes);
+	} else {
+		decode_strands(hmm, dna, ft, expected, plus_genes, anti_genes);
+	}
+}
+
+static int split_at_gaps (const zoeDNA dna, coor_t ** from, coor_t ** length) {
+	coor_t i, gap, start;
+	int    count = 0, limit = 0;
+	
+	/* segments are what remains after removing N runs of at least SNAP_GAP */
+	*from   = NULL;
+	*length = NULL;
+	start   = 0;
+	i       = 0;
+	while (i <= dna->length) {
+		if (i < dna->length && dna->s5[i] != 4) {
+			i++;
+			continue;
 		}
-		zoeDeleteDNA(anti_dna);
+		for (gap = i; gap < dna->length && dna->s5[gap] == 4; gap++);
+		if (i == dna->length || gap - i >= SNAP_GAP) {
+			if (i > start) {
+				if (count == limit) {
+					limit = (limit == 0) ? 16 : limit * 2;
+					*from   = zoeRealloc(*from,   limit * sizeof(coor_t));
+					*length = zoeRealloc(*length, limit * sizeof(coor_t));
+				}
+				(*from)[count]   = start;
+				(*length)[count] = i - start;
+				count++;
+			}
+			start = gap;
+		}
+		i = (gap > i) ? gap : i + 1;
 	}
 	
+	return count;
+}
+
+struct segment_job {
+	zoeHMM          hmm;
+	zoeDNA          dna;
+	zoeFeatureTable ft;
+	score_t         expected;
+	int             count;
+	int             next;   /* next segment to decode, taken under SNAP_LOCK */
+	coor_t        * from;
+	coor_t        * length;
+	zoeVec        * plus;   /* genes of each segment, in sequence coordinates */
+	zoeVec        * anti;
+};
+
+static void * segment_worker (void * arg) {
+	struct segment_job * job = arg;
+	int                  i;
+	zoeDNA               seg;
+	zoeFeatureTable      sft;
+	zoeVec               plus, anti;
+	coor_t               from, length;
+	
+	while (1) {
+		pthread_mutex_lock(&SNAP_LOCK);
+		i = job->next++;
+		pthread_mutex_unlock(&SNAP_LOCK);
+		if (i >= job->count) break;
+		
+		from   = job->from[i];
+		length = job->length[i];
+		seg = zoeSubseqDNA(job->dna->def, job->dna, from, length);
+		sft = (job->ft) ? window_xdef(job->ft, from, length) : NULL;
+		
+		decode_region(job->hmm, seg, sft, job->expected, &plus, &anti);
+		job->plus[i] = zoeNewVec();
+		job->anti[i] = zoeNewVec();
+		keep_window_genes(plus, job->plus[i], job->dna, from, length, from, from + length -1);
+		keep_window_genes(anti, job->anti[i], job->dna, from, length, from, from + length -1);
+		
+		if (sft) zoeDeleteFeatureTable(sft);
+		zoeDeleteDNA(seg);
+		if (SNAP_METER) zoeE(".");
+	}
+	
+	return NULL;
+}
+
+static void decode_segments (const zoeHMM hmm, const zoeDNA dna, const zoeFeatureTable ft, zoeVec * plus_genes, zoeVec * anti_genes) {
+	struct segment_job job;
+	pthread_t        * threads;
+	int                i, j, workers;
+	
+	/*
+		No gene can span a long assembly gap, so each segment between
+		gaps gets its own trellis. Segments are independent and are
+		handed out to a pool of workers; the results are merged in
+		sequence order so the output does not depend on scheduling.
+	*/
+	
+	job.count = split_at_gaps(dna, &job.from, &job.length);
+	if (job.count == 1 && job.length[0] == dna->length) {
+		zoeFree(job.from);
+		zoeFree(job.length);
+		decode_region(hmm, dna, ft, MIN_SCORE, plus_genes, anti_genes);
+		return;
+	}
+	
+	job.hmm      = hmm;
+	job.dna      = dna;
+	job.ft       = ft;
+	job.expected = zoeExpectedScore(dna); /* null model of the whole sequence */
+	job.next     = 0;
+	job.plus     = zoeMalloc(job.count * sizeof(zoeVec));
+	job.anti     = zoeMalloc(job.count * sizeof(zoeVec));
+	
+	/* serial under -debug so that the debugging output is not interleaved */
+	workers = SNAP_THREADS;
+	if (workers > job.count) workers = job.count;
+	if (zoeOption("-debug") || zoeOption("-xdebug")) workers = 1;
+	
+	threads = zoeMalloc(workers * sizeof(pthread_t));
+	for (i = 1; i < workers; i++) {
+		if (pthread_create(&threads[i], NULL, segment_worker, &job) != 0) {
+			zoeExit("decode_segments failed to create worker thread");
+		}
+	}
+	segment_worker(&job);
+	for (i = 1; i < workers; i++) {
+		if (pthread_join(threads[i], NULL) != 0) {
+			zoeExit("decode_segments failed to join worker thread");
+		}
+	}
+	
+	*plus_genes = zoeNewVec();
+	*anti_genes = zoeNewVec();
+	for (i = 0; i < job.count; i++) {
+		for (j = 0; j < job.plus[i]->size; j++) zoePushVec(*plus_genes, job.plus[i]->elem[j]);
+		for (j = 0; j < job.anti[i]->size; j++) zoePushVec(*anti_genes, job.anti[i]->elem[j]);
+		zoeDeleteVec(job.plus[i]);
+		zoeDeleteVec(job.anti[i]);
+	}
+	
+	zoeFree(threads);
+	zoeFree(job.plus);
+	zoeFree(job.anti);
+	zoeFree(job.from);
+	zoeFree(job.length);
+}
+
+static zoeVec resolve_genes (zoeVec plus_genes, zoeVec anti_genes, const zoeDNA plus_dna, int parse) {
+	zoeVec               genes, keep;
+	zoeCDS               gene, a, b;
+	int                  i, j, both_passed, pair_count, pair_limit;
+	char                 id[64], name[256];
+	struct ranked_gene * ranked;
+	struct gene_pair   * pairs;
+	
 	/****************************************\
 		Both strands, sort out differences
 	\****************************************/
@@ -563,35 +1148,59 @@ zoeVec parse_dna (const zoeHMM hmm, const zoeDNA plus_dna, zoeFeatureTable ft) {
 	/* sort genes by score */
 	qsort(genes->elem, genes->size, sizeof(zoeCDS), cmp_genes_ptr_by_score);
 
-	/* compare genes */
+	/* find overlapping pairs with a sweep over gene starts */
+	ranked = zoeMalloc((genes->size +1) * sizeof(struct ranked_gene));
+	for (i = 0; i < genes->size; i++) {
+		ranked[i].gene = genes->elem[i];
+		ranked[i].rank = i;
+	}
+	qsort(ranked, genes->size, sizeof(struct ranked_gene), cmp_ranked_ptr_by_start);
+	
+	pairs      = NULL;
+	pair_count = 0;
+	pair_limit = 0;
 	for (i = 0; i < genes->size; i++) {
-		a = genes->elem[i];
 		for (j = i+1; j < genes->size; j++) {
-			b = genes->elem[j];
-			if (!zoeCDSsOverlap(a, b)) continue;
-			
-			if (gene_in_intron(a, b) || gene_in_intron(b, a)) {
-				if (zoeOption("-info")) zoeE("intronic genes %s %s\n", a->name, b->name);
-				continue;
-			}
-			
-			both_passed = 0;
-			if      (a->score > SNAP_OVERLAP && b->score > SNAP_OVERLAP) both_passed = 1;
-			else if (a->score > SNAP_OVERLAP)  b->score = MIN_SCORE;
-			else if (b->score > SNAP_OVERLAP)  a->score = MIN_SCORE;
-			else if (a->score > b->score) b->score = MIN_SCORE;
-			else if (b->score > a->score) a->score = MIN_SCORE;
-			else  {
-				a->score = MIN_SCORE;
-				b->score = MIN_SCORE;
-			}
-			
-			/* may do something else when both pass */
-			if (both_passed) {
-				if (zoeOption("-info")) zoeE("overlap passed threshold %s %s\n", a->name, b->name);
+			if (ranked[j].gene->start > ranked[i].gene->end) break;
+			if (pair_count == pair_limit) {
+				pair_limit = (pair_limit == 0) ? 64 : pair_limit * 2;
+				pairs = zoeRealloc(pairs, pair_limit * sizeof(struct gene_pair));
 			}
+			pairs[pair_count].a = (ranked[i].rank < ranked[j].rank) ? ranked[i].rank : ranked[j].rank;
+			pairs[pair_count].b = (ranked[i].rank < ranked[j].rank) ? ranked[j].rank : ranked[i].rank;
+			pair_count++;
+		}
+	}
+	zoeFree(ranked);
+	
+	/* compare genes, in the same order as a pass over all pairs by score */
+	qsort(pairs, pair_count, sizeof(struct gene_pair), cmp_pairs);
+	for (i = 0; i < pair_count; i++) {
+		a = genes->elem[pairs[i].a];
+		b = genes->elem[pairs[i].b];
+		
+		if (gene_in_intron(a, b) || gene_in_intron(b, a)) {
+			if (zoeOption("-info")) zoeE("intronic genes %s %s\n", a->name, b->name);
+			continue;
+		}
+		
+		both_passed = 0;
+		if      (a->score > SNAP_OVERLAP && b->score > SNAP_OVERLAP) both_passed = 1;
+		else if (a->score > SNAP_OVERLAP)  b->score = MIN_SCORE;
+		else if (b->score > SNAP_OVERLAP)  a->score = MIN_SCORE;
+		else if (a->score > b->score) b->score = MIN_SCORE;
+		else if (b->score > a->score) a->score = MIN_SCORE;
+		else  {
+			a->score = MIN_SCORE;
+			b->score = MIN_SCORE;
+		}
+		
+		/* may do something else when both pass */
+		if (both_passed) {
+			if (zoeOption("-info")) zoeE("overlap passed threshold %s %s\n", a->name, b->name);
 		}
 	}
+	if (pairs) zoeFree(pairs);
 	
 	/* throw out MIN_SCORE genes*/
 	keep = zoeNewVec();
@@ -617,6 +1226,7 @@ zoeVec parse_dna (const zoeHMM hmm, const zoeDNA plus_dna, zoeFeatureTable ft) {
 	for (i = 0; i < keep->size; i++) {
 		if (zoeOption("-name")) sprintf(name, "%s-%s.%d", id, zoeOption("-name"), i+1);
 		else                    sprintf(name, "%s-snap.%d", id, i+1);
+		if (parse > 1) sprintf(name + strlen(name), "-p%d", parse); /* -kbest */
 		
 		gene = keep->elem[i];
 		
@@ -639,11 +1249,201 @@ zoeVec parse_dna (const zoeHMM hmm, const zoeDNA plus_dna, zoeFeatureTable ft) {
 		edit_names(gene->exons,   name);
 		edit_names(gene->introns, name);
 		/*edit_names(gene->source,  name);*/
+		if (gene->post) edit_names(gene->post, name);
 	}
 	
 	return keep;
 }
 
+zoeVec parse_dna (const zoeHMM hmm, const zoeDNA plus_dna, zoeFeatureTable ft) {
+	zoeVec plus_genes = NULL, anti_genes = NULL;
+	
+	/* decode */
+	if (SNAP_METER) zoeE("decoding %s", plus_dna->def);
+	if (SNAP_ROUNDS > 1) {
+		decode_session(hmm, plus_dna, ft, &plus_genes, &anti_genes);
+	} else if (SNAP_GAP) {
+		decode_segments(hmm, plus_dna, ft, &plus_genes, &anti_genes);
+	} else {
+		decode_region(hmm, plus_dna, ft, MIN_SCORE, &plus_genes, &anti_genes);
+	}
+	if (SNAP_METER) zoeE(" done\n");
+	
+	return resolve_genes(plus_genes, anti_genes, plus_dna, 1);
+}
+
+struct parse_pair {
+	score_t score; /* sum over the strands */
+	int     rank[2];
+};
+
+static int cmp_parse_pairs (const void * a, const void * b) {
+	const struct parse_pair * p = a;
+	const struct parse_pair * q = b;
+	
+	/* the viterbi parse of each strand first, it is what snap reports without -kbest */
+	if (p->rank[0] + p->rank[1] == 0) return -1;
+	if (q->rank[0] + q->rank[1] == 0) return  1;
+	if (p->score > q->score) return -1;
+	if (p->score < q->score) return  1;
+	if (p->rank[0] != q->rank[0]) return p->rank[0] - q->rank[0];
+	return p->rank[1] - q->rank[1];
+}
+
+static int same_genes (const zoeVec a, const zoeVec b) {
+	int        i, j;
+	zoeCDS     g, h;
+	zoeFeature e, f;
+	
+	/* same exons in the same order, names aside */
+	if (a->size != b->size) return 0;
+	for (i = 0; i < a->size; i++) {
+		g = a->elem[i];
+		h = b->elem[i];
+		if (g->exons->size != h->exons->size) return 0;
+		for (j = 0; j < g->exons->size; j++) {
+			e = g->exons->elem[j];
+			f = h->exons->elem[j];
+			if (e->label != f->label || e->start != f->start || e->end != f->end
+				|| e->strand != f->strand || e->inc5 != f->inc5 || e->inc3 != f->inc3)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static zoeVec strand_parse (struct strand_job * job, int rank) {
+	zoeVec genes;
+	int    i;
+	
+	genes = zoeGetParseGenes(job->trellis, rank);
+	gene_posteriors(job->trellis, genes);
+	if (job->strand == '-') {
+		for (i = 0; i < genes->size; i++) zoeAntiCDS(genes->elem[i], job->dna->length);
+	}
+	return genes;
+}
+
+static void delete_genes (zoeVec genes) {
+	int i;
+	
+	for (i = 0; i < genes->size; i++) zoeDeleteCDS(genes->elem[i]);
+	zoeDeleteVec(genes);
+}
+
+static int distinct_parses (struct strand_job * job, int * rank) {
+	zoeVec   seen, genes;
+	int      i, j, size = 0;
+	
+	/* ranks of a strand whose genes differ from all better ranks */
+	seen = zoeNewVec();
+	for (i = 0; i < job->trellis->parses; i++) {
+		genes = zoeGetParseGenes(job->trellis, i);
+		for (j = 0; j < seen->size; j++) {
+			if (same_genes(seen->elem[j], genes)) break;
+		}
+		if (j < seen->size) {
+			delete_genes(genes);
+		} else {
+			zoePushVec(seen, genes);
+			rank[size++] = i;
+		}
+	}
+	for (j = 0; j < seen->size; j++) delete_genes(seen->elem[j]);
+	zoeDeleteVec(seen);
+	
+	return size;
+}
+
+static zoeVec kbest_parses (const zoeHMM hmm, const zoeDNA plus_dna, zoeFeatureTable ft, int * full) {
+	struct strand_job   job[2];
+	struct parse_pair * pairs;
+	zoeVec              parses, genes[2], plus_genes, anti_genes, keep;
+	int                 i, j, n, count, size[2], * rank[2];
+	
+	/*
+		The strands are decoded independently, so the best joint parses
+		are the best sums of one parse from each strand. Parses that
+		differ only in what is not reported (ORFs, repeats, filtered
+		genes) are reported once.
+	*/
+	
+	count = open_strands(job, hmm, plus_dna, ft, MIN_SCORE);
+	*full = 0;
+	for (i = 0; i < 2; i++) {
+		rank[i] = zoeMalloc(job[0].trellis->kbest * sizeof(int));
+		rank[i][0] = 0;
+		size[i]    = 1;
+	}
+	for (i = 0; i < count; i++) {
+		delete_genes(job[i].genes); /* traced again for each parse below */
+		size[i] = distinct_parses(&job[i], rank[i]);
+		if (job[i].trellis->parses == job[i].trellis->kbest) *full = 1;
+	}
+	
+	pairs = zoeMalloc(size[0] * size[1] * sizeof(struct parse_pair));
+	n = 0;
+	for (i = 0; i < size[0]; i++) {
+		for (j = 0; j < size[1]; j++) {
+			pairs[n].score   = job[0].trellis->parse[rank[0][i]].score;
+			if (count == 2) pairs[n].score += job[1].trellis->parse[rank[1][j]].score;
+			pairs[n].rank[0] = rank[0][i];
+			pairs[n].rank[1] = rank[1][j];
+			n++;
+		}
+	}
+	qsort(pairs, n, sizeof(struct parse_pair), cmp_parse_pairs);
+	
+	parses = zoeNewVec();
+	for (i = 0; i < n && parses->size < SNAP_KBEST; i++) {
+		plus_genes = NULL;
+		anti_genes = NULL;
+		for (j = 0; j < count; j++) {
+			genes[j] = strand_parse(&job[j], pairs[i].rank[j]);
+			if (job[j].strand == '+') plus_genes = genes[j];
+			else                      anti_genes = genes[j];
+		}
+		if (plus_genes == NULL) plus_genes = zoeNewVec();
+		if (anti_genes == NULL) anti_genes = zoeNewVec();
+		keep = resolve_genes(plus_genes, anti_genes, plus_dna, parses->size +1);
+		
+		/* overlap filtering can still make two parses alike */
+		for (j = 0; j < parses->size; j++) {
+			if (same_genes(parses->elem[j], keep)) break;
+		}
+		if (j == parses->size) zoePushVec(parses, keep);
+		else                   delete_genes(keep);
+	}
+	
+	zoeFree(pairs);
+	for (i = 0; i < 2; i++) zoeFree(rank[i]);
+	for (i = 0; i < count; i++) end_strand(&job[i]);
+	
+	return parses;
+}
+
+static zoeVec parse_dna_kbest (const zoeHMM hmm, const zoeDNA plus_dna, zoeFeatureTable ft) {
+	zoeVec parses;
+	int    i, draw, full;
+	
+	/* more ranks until k parses differ, the ranks run out or SNAP_DRAW is reached */
+	if (SNAP_METER) zoeE("decoding %s", plus_dna->def);
+	for (draw = SNAP_KBEST; ; draw *= 2) {
+		zoeSetTrellisKBest(draw);
+		parses = kbest_parses(hmm, plus_dna, ft, &full);
+		if (parses->size == SNAP_KBEST || !full || draw * 2 > SNAP_KBEST * SNAP_DRAW) break;
+		for (i = 0; i < parses->size; i++) delete_genes(parses->elem[i]);
+		zoeDeleteVec(parses);
+	}
+	zoeSetTrellisKBest(SNAP_KBEST);
+	if (SNAP_METER) zoeE(" done\n");
+	if (parses->size < SNAP_KBEST && full) {
+		zoeWarn("%s: %d distinct parses in the best %d ranks", plus_dna->def, parses->size, draw);
+	}
+	
+	return parses;
+}
+
 
 /* output formatting */
 